@@ -11,6 +11,8 @@ namespace wc
 	class Application 
 	{
 		GameInstance game;
+		static constexpr uint32_t ProfileFrameCount = 120; // F8 captures this many frames
+		uint32_t m_ProfileCount = 0;
 		//----------------------------------------------------------------------------------------------------------------------
 		bool IsEngineOK() { return Globals.window.IsOpen(); }
 		//----------------------------------------------------------------------------------------------------------------------
@@ -31,6 +33,7 @@ namespace wc
 		//----------------------------------------------------------------------------------------------------------------------
 		void OnCreate() 
 		{
+			Profiler::Get().SetThreadName("Main");
 			VulkanContext::Create();
 
 			Globals.settings.Load();
@@ -80,6 +83,9 @@ namespace wc
 				else if (Globals.gameState == GameState::PLAY) Globals.gameState = GameState::PAUSE;
 			}
 
+			// Chrome trace of the next frames, open it in chrome://tracing or ui.perfetto.dev
+			if (ImGui::IsKeyPressed(ImGuiKey_F8, false)) Profiler::Get().Capture(ProfileFrameCount, std::format("profile_{}.json", m_ProfileCount++));
+
 			if (Globals.window.HasFocus() && Globals.gameState == GameState::PLAY)
 				game.InputGame();
 		}
@@ -218,7 +224,10 @@ namespace wc
 
 		void OnUpdate()
 		{
-			SyncContext::GetRenderFence().Wait();
+			{
+				WC_PROFILE_SCOPE("Wait for render fence");
+				SyncContext::GetRenderFence().Wait();
+			}
 			SyncContext::GetRenderFence().Reset();
 			SyncContext::GetMainCommandBuffer().Reset();
 
@@ -238,18 +247,21 @@ namespace wc
 			}
 
 
-			ImGui_ImplGlfw_NewFrame();
-			ImGui::NewFrame();
-			ImGuizmo::BeginFrame();
-			if (Globals.gameState == GameState::MENU) game.MAIN_MENU();
-			else if (Globals.gameState == GameState::DEATH) game.DEATH_MENU();
-			else if (Globals.gameState == GameState::WIN) game.WIN_MENU();
-			else if (Globals.gameState == GameState::PLAY) game.UI();
-			else if (Globals.gameState == GameState::LOADOUT) game.LOADOUT_MENU();
-			else if (Globals.gameState == GameState::CREDITS) Credits();
-			else if (Globals.gameState == GameState::SETTINGS) game.SETTINGS_MENU();
-			else if (Globals.gameState == GameState::PAUSE) game.PAUSE_MENU();
-			ImGui::Render();			
+			{
+				WC_PROFILE_SCOPE("ImGui frame");
+				ImGui_ImplGlfw_NewFrame();
+				ImGui::NewFrame();
+				ImGuizmo::BeginFrame();
+				if (Globals.gameState == GameState::MENU) game.MAIN_MENU();
+				else if (Globals.gameState == GameState::DEATH) game.DEATH_MENU();
+				else if (Globals.gameState == GameState::WIN) game.WIN_MENU();
+				else if (Globals.gameState == GameState::PLAY) game.UI();
+				else if (Globals.gameState == GameState::LOADOUT) game.LOADOUT_MENU();
+				else if (Globals.gameState == GameState::CREDITS) Credits();
+				else if (Globals.gameState == GameState::SETTINGS) game.SETTINGS_MENU();
+				else if (Globals.gameState == GameState::PAUSE) game.PAUSE_MENU();
+				ImGui::Render();
+			}
 
 			if (Globals.gameState == GameState::PLAY) game.Update();
 			CommandBuffer& cmd = SyncContext::GetMainCommandBuffer();
@@ -265,7 +277,10 @@ namespace wc
 			clearValue.color = { 0.f, 0.f, 0.f, 0.f };
 			rpInfo.pClearValues = &clearValue;
 
-			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd, rpInfo, VK_NULL_HANDLE);
+			{
+				WC_PROFILE_SCOPE("ImGui_ImplVulkan_RenderDrawData");
+				ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd, rpInfo, VK_NULL_HANDLE);
+			}
 
 			ImGui::UpdatePlatformWindows();
 			ImGui::RenderPlatformWindowsDefault();
@@ -334,15 +349,22 @@ namespace wc
 		//----------------------------------------------------------------------------------------------------------------------
 	public:
 
+		// Every level attempt is recorded for --replay, see InputRecording.h
+		void SetRecordPath(const std::string& path) { game.RecordPath = path; }
+
 		void Start()
 		{
 			OnCreate();
 
 			while (IsEngineOK())
 			{
-				OnInput();
+				{
+					WC_PROFILE_SCOPE("Frame");
+					OnInput();
 
-				OnUpdate();
+					OnUpdate();
+				}
+				Profiler::Get().EndFrame();
 			}
 
 			OnDelete();
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string_view>
+
+#include "bench/RenderBenchmarks.h"
+#include "bench/ParticleBenchmarks.h"
+#include "bench/RaycastBenchmarks.h"
+#include "bench/SimulationBenchmarks.h"
+#include "game/HeadlessSimulation.h"
+
+namespace wc
+{
+	// The commands Cubit and CubitHeadless share, none of them needs a window, Vulkan device, ImGui or audio.
+	// Returns false if argv holds none of them, otherwise exitCode is set to the command's result
+	inline bool RunCommandLine(int argc, char** argv, int& exitCode)
+	{
+		if (argc < 2) return false;
+		std::string_view command = argv[1];
+
+		// CPU-only benchmarks. --bench [results.json]
+		if (command == "--bench")
+		{
+			Bench::RunQuadBenchmarks();
+			Bench::RunParticleBenchmarks();
+			Bench::RunRaycastBenchmarks();
+			Bench::RunSimulationBenchmarks();
+			exitCode = argc > 2 ? (Bench::WriteJson(argv[2]) ? 0 : 1) : 0;
+			return true;
+		}
+
+		// Fixed-step simulation of a level with scripted input
+		if (command == "--headless")
+		{
+			exitCode = RunHeadless(argc, argv);
+			return true;
+		}
+
+		// Replays a --record session headless and checks it stays bit-exact
+		if (command == "--replay")
+		{
+			exitCode = RunReplay(argc, argv);
+			return true;
+		}
+
+		// Turns a .malen + .metadata pair into a binary level. --convert <level.malen> [out.cblv]
+		if (command == "--convert")
+		{
+			if (argc < 3)
+			{
+				WC_CORE_ERROR("Usage: --convert <level.malen> [out{}]", LevelExtension);
+				exitCode = 1;
+			}
+			else exitCode = LevelFile::Convert(argv[2], argc > 3 ? argv[3] : "") ? 0 : 1;
+			return true;
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,26 @@
+// Entry point of the CubitHeadless target: simulation and CPU benchmarks only, built without Vulkan, GLFW,
+// ImGui or audio so it runs on machines without a GPU. The game itself is built from main.cpp
+
+#define GLM_FORCE_CTOR_INIT
+#define GLM_FORCE_SILENT_WARNINGS
+
+#include "CommandLine.h"
+
+namespace wc
+{
+	int main(int argc, char** argv)
+	{
+		Log::Init();
+
+		int exitCode = 0;
+		if (RunCommandLine(argc, argv, exitCode)) return exitCode;
+
+		WC_CORE_ERROR("Usage: CubitHeadless --headless [level] [ticks] [input script] | --replay <recording> | --bench [results.json] | --convert <level.malen> [out.cblv]");
+		return 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	return wc::main(argc, argv);
+}
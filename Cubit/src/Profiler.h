@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <wc/Utils/Log.h>
+
+// Set WC_PROFILER to 0 to compile every zone out, captures then produce empty traces
+#ifndef WC_PROFILER
+#define WC_PROFILER 1
+#endif
+
+namespace wc
+{
+	// Scoped CPU zones for frame captures, written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+	// Nothing is recorded outside a capture, an idle zone costs one relaxed atomic load.
+	// Every thread appends to its own buffer and publishes the count with a release store, so zones never lock
+	class Profiler
+	{
+	public:
+		struct Event
+		{
+			const char* Name; // Only the pointer is kept, names have to be string literals
+			int64_t Start; // Nanoseconds since the profiler was created
+			int64_t End;
+		};
+
+		static constexpr uint32_t EventsPerTrack = 1 << 16;
+
+		// One row in the trace. Every thread gets its own, AddTrack makes more for timings that don't come from a CPU thread
+		struct Track
+		{
+			std::unique_ptr<Event[]> Events = std::make_unique<Event[]>(EventsPerTrack);
+			std::atomic<uint32_t> Count = 0;
+			std::atomic<uint32_t> Capture = 0; // Capture the events belong to
+			std::atomic<uint32_t> Dropped = 0;
+			uint32_t ThreadID = 0;
+			std::string Name;
+			std::string Category = "cpu";
+		};
+
+		static Profiler& Get()
+		{
+			static Profiler profiler;
+			return profiler;
+		}
+
+		bool IsRecording() const { return m_Recording.load(std::memory_order_relaxed); }
+
+		int64_t Now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Epoch).count(); }
+
+		// Events past EventsPerTrack are dropped and reported when the capture is written
+		void Record(const char* name, int64_t start, int64_t end) { Record(GetTrack(), name, start, end); }
+
+		// Only one thread at a time may record into a track
+		void Record(Track& track, const char* name, int64_t start, int64_t end)
+		{
+			// The recording thread starts the track over when it first records into a new capture
+			uint32_t capture = m_Capture.load(std::memory_order_relaxed);
+			uint32_t count = track.Capture.load(std::memory_order_relaxed) == capture ? track.Count.load(std::memory_order_relaxed) : 0;
+			if (count == 0)
+			{
+				track.Count.store(0, std::memory_order_relaxed);
+				track.Dropped.store(0, std::memory_order_relaxed);
+				track.Capture.store(capture, std::memory_order_release);
+			}
+
+			if (count == EventsPerTrack)
+			{
+				track.Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			track.Events[count] = { name, start, end };
+			track.Count.store(count + 1, std::memory_order_release);
+		}
+
+		// Tracks live as long as the profiler, an empty name is replaced with a numbered one
+		Track& AddTrack(const std::string& name, const std::string& category = "cpu")
+		{
+			std::lock_guard lock(m_Mutex);
+			Track& track = *m_Tracks.emplace_back(std::make_unique<Track>());
+			track.ThreadID = (uint32_t)m_Tracks.size();
+			track.Name = name.empty() ? std::format("Thread {}", track.ThreadID) : name;
+			track.Category = category;
+			return track;
+		}
+
+		// Shown as the track name in the trace
+		void SetThreadName(const std::string& name)
+		{
+			Track& buffer = GetTrack();
+			std::lock_guard lock(m_Mutex);
+			buffer.Name = name;
+		}
+
+		// Records the next frameCount frames and writes them to filepath. Ignored while a capture is running
+		void Capture(uint32_t frameCount, const std::string& filepath)
+		{
+			if (IsRecording() || frameCount == 0) return;
+
+			m_CapturePath = filepath;
+			m_FramesLeft = frameCount;
+			m_Capture.fetch_add(1, std::memory_order_relaxed);
+			m_Recording.store(true, std::memory_order_release);
+			WC_CORE_INFO("Profiler: capturing {} frames", frameCount);
+		}
+
+		// Call at the end of every frame on the main thread, finishes a capture after its last frame
+		void EndFrame()
+		{
+			if (!IsRecording() || --m_FramesLeft > 0) return;
+
+			m_Recording.store(false, std::memory_order_relaxed);
+			WriteChromeTrace(m_CapturePath);
+		}
+
+		// Complete ("X") events with microsecond timestamps, one row per track. Zones other threads close
+		// while this runs are left out
+		bool WriteChromeTrace(const std::string& filepath)
+		{
+			std::ofstream file(filepath);
+			if (!file.is_open())
+			{
+				WC_CORE_ERROR("Could not write profile {}", filepath);
+				return false;
+			}
+
+			std::lock_guard lock(m_Mutex);
+			uint32_t capture = m_Capture.load(std::memory_order_relaxed);
+			uint64_t eventCount = 0;
+			uint64_t droppedCount = 0;
+
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			const char* separator = "\n";
+			for (const auto& buffer : m_Tracks)
+			{
+				file << separator << std::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", buffer->ThreadID, buffer->Name);
+				separator = ",\n";
+
+				if (buffer->Capture.load(std::memory_order_acquire) != capture) continue;
+				uint32_t count = buffer->Count.load(std::memory_order_acquire);
+
+				for (uint32_t i = 0; i < count; i++)
+				{
+					const Event& event = buffer->Events[i];
+					file << separator << std::format(R"({{"name":"{}","cat":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+						event.Name, buffer->Category, buffer->ThreadID, event.Start * 1e-3, (event.End - event.Start) * 1e-3);
+				}
+				eventCount += count;
+				droppedCount += buffer->Dropped.load(std::memory_order_relaxed);
+			}
+			file << "\n]}\n";
+
+			if (droppedCount > 0) WC_CORE_WARN("Profiler: {} zones did not fit into their tracks", droppedCount);
+			WC_CORE_INFO("Profiler: wrote {} zones to {}", eventCount, filepath);
+			return file.good();
+		}
+	private:
+		// Registered the first time a thread records, tracks outlive their threads so the exporter never sees a dangling one
+		Track& GetTrack()
+		{
+			thread_local Track* buffer = nullptr;
+			if (!buffer) buffer = &AddTrack("");
+			return *buffer;
+		}
+
+		std::chrono::steady_clock::time_point m_Epoch = std::chrono::steady_clock::now();
+
+		std::atomic<bool> m_Recording = false;
+		std::atomic<uint32_t> m_Capture = 0;
+		uint32_t m_FramesLeft = 0;
+		std::string m_CapturePath;
+
+		std::mutex m_Mutex;
+		std::vector<std::unique_ptr<Track>> m_Tracks;
+	};
+
+	// Records the time between its construction and destruction if a capture was running when it started
+	class ProfileZone
+	{
+		const char* m_Name;
+		int64_t m_Start = -1;
+	public:
+		explicit ProfileZone(const char* name) : m_Name(name)
+		{
+			if (Profiler::Get().IsRecording()) m_Start = Profiler::Get().Now();
+		}
+
+		~ProfileZone()
+		{
+			if (m_Start >= 0) Profiler::Get().Record(m_Name, m_Start, Profiler::Get().Now());
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+	};
+}
+
+#if WC_PROFILER
+#define WC_PROFILE_CONCAT_IMPL(a, b) a##b
+#define WC_PROFILE_CONCAT(a, b) WC_PROFILE_CONCAT_IMPL(a, b)
+#define WC_PROFILE_SCOPE(name) ::wc::ProfileZone WC_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define WC_PROFILE_FUNCTION() WC_PROFILE_SCOPE(__FUNCTION__)
+#else
+#define WC_PROFILE_SCOPE(name)
+#define WC_PROFILE_FUNCTION()
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <random>
+#include <glm/glm.hpp>
+
+namespace wc
+{
+	// xoshiro128** (Blackman and Vigna), 16 bytes of state and a few instructions per number.
+	// Not suitable for anything security related
+	class Random
+	{
+		uint32_t m_State[4];
+	public:
+		explicit Random(uint64_t seed = 0) { Seed(seed); }
+
+		// Expands the seed with splitmix64 so similar seeds still give unrelated streams
+		void Seed(uint64_t seed)
+		{
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+				z ^= z >> 31;
+				m_State[i * 2] = (uint32_t)z;
+				m_State[i * 2 + 1] = (uint32_t)(z >> 32);
+			}
+		}
+
+		uint32_t NextUint()
+		{
+			uint32_t result = std::rotl(m_State[1] * 5, 7) * 9;
+			uint32_t t = m_State[1] << 9;
+
+			m_State[2] ^= m_State[0];
+			m_State[3] ^= m_State[1];
+			m_State[1] ^= m_State[2];
+			m_State[0] ^= m_State[3];
+			m_State[2] ^= t;
+			m_State[3] = std::rotl(m_State[3], 11);
+			return result;
+		}
+
+		uint64_t NextUint64() { return (uint64_t)NextUint() << 32 | NextUint(); }
+
+		// Uniform in [0, 1), the top 24 bits fill the float mantissa exactly
+		float NextFloat() { return (NextUint() >> 8) * 0x1p-24f; }
+
+		// Uniform in [min, max)
+		float Range(float min, float max) { return min + (max - min) * NextFloat(); }
+
+		// Uniform in [min, max], both inclusive
+		int32_t Range(int32_t min, int32_t max)
+		{
+			uint64_t range = (uint64_t)((int64_t)max - min) + 1;
+			return (int32_t)(min + (int64_t)((NextUint() * range) >> 32));
+		}
+
+		// Both components uniform in [min, max), x is drawn first
+		glm::vec2 RangeVec2(float min, float max)
+		{
+			float x = Range(min, max);
+			float y = Range(min, max);
+			return { x, y };
+		}
+
+		bool NextBool() { return NextUint() >> 31; }
+
+		// Batch versions for emitting many particles at once
+		void Fill(float* values, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++) values[i] = NextFloat();
+		}
+
+		void Fill(float* values, uint32_t count, float min, float max)
+		{
+			for (uint32_t i = 0; i < count; i++) values[i] = Range(min, max);
+		}
+	};
+
+	// Threads seed their generator from this the first time they use it. Starts out random,
+	// SeedRandom makes a run reproducible
+	inline std::atomic<uint64_t> RandomSeed = std::random_device()() | (uint64_t)std::random_device()() << 32;
+	inline std::atomic<uint32_t> RandomThreadCount = 0;
+
+	// Generator of the calling thread, every thread gets its own stream derived from RandomSeed
+	inline Random& GetRandom()
+	{
+		thread_local Random random(RandomSeed.load() + 0xD1B54A32D192ED03ull * RandomThreadCount++);
+		return random;
+	}
+
+	// Reseeds the calling thread's generator, threads started afterwards derive their streams from seed
+	inline void SeedRandom(uint64_t seed)
+	{
+		RandomSeed = seed;
+		GetRandom().Seed(seed);
+	}
+
+	inline float RandomValue() { return GetRandom().NextFloat(); }
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace wc
+{
+	// World space rectangle of everything the camera can see
+	struct CullRect
+	{
+		glm::vec2 Min = glm::vec2(-FLT_MAX);
+		glm::vec2 Max = glm::vec2(FLT_MAX);
+
+		bool Overlaps(glm::vec2 min, glm::vec2 max) const { return max.x >= Min.x && min.x <= Max.x && max.y >= Min.y && min.y <= Max.y; }
+		bool OverlapsCentered(glm::vec2 center, glm::vec2 halfSize) const { return Overlaps(center - halfSize, center + halfSize); }
+	};
+
+	struct CullCounter
+	{
+		uint32_t Submitted = 0;
+		uint32_t Culled = 0;
+
+		// Returns visible so it can be used directly as the draw condition
+		bool Count(bool visible)
+		{
+			if (visible) Submitted++;
+			else Culled++;
+			return visible;
+		}
+	};
+
+	struct CullingStats
+	{
+		CullCounter Tiles;
+		CullCounter Entities;
+		CullCounter Particles;
+		CullCounter Text;
+	};
+}
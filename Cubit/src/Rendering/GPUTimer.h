@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <format>
+#include <vector>
+
+#include <wc/vk/SyncContext.h>
+
+#include "../Profiler.h"
+
+namespace wc
+{
+	// GPU time of named passes from timestamp queries. Every frame in flight has its own query pool, which is read
+	// back and reset from the host when that frame comes around again after the render fence, so nothing ever waits
+	// on the GPU and no queue has to reset queries another queue writes.
+	// Scopes open a debug label of the same name too, graphics debuggers show the same passes
+	class GPUTimer
+	{
+	public:
+		static constexpr uint32_t MaxScopes = 32; // Per frame, later scopes only get their label
+
+		struct Timing
+		{
+			const char* Name = nullptr;
+			uint32_t Depth = 0; // Number of scopes it is nested in
+			float Milliseconds = 0.f; // Last frame that was read back
+			float Average = 0.f; // Moving average, steadier for the overlay
+		};
+
+		void Create()
+		{
+			VkPhysicalDeviceProperties properties = VulkanContext::GetProperties();
+			m_TimestampPeriod = properties.limits.timestampPeriod;
+			m_Supported = properties.limits.timestampComputeAndGraphics && m_TimestampPeriod > 0.f;
+			if (!m_Supported)
+			{
+				WC_CORE_WARN("Device has no timestamps on all graphics and compute queues, GPU timings are disabled");
+				return;
+			}
+
+			m_Supported = VulkanContext::GetSupportedFeatures12().hostQueryReset;
+			if (!m_Supported)
+			{
+				WC_CORE_WARN("Device can't reset queries from the host, GPU timings are disabled");
+				return;
+			}
+
+			VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+			info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			info.queryCount = MaxScopes * 2;
+			for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
+			{
+				VK_CHECK(vkCreateQueryPool(VulkanContext::GetLogicalDevice(), &info, VulkanContext::GetAllocator(), &m_Frames[i].Pool));
+				VulkanContext::SetObjectName(VK_OBJECT_TYPE_QUERY_POOL, (uint64_t)m_Frames[i].Pool, std::format("GPUTimer::Pool[{}]", i).c_str());
+				vkResetQueryPool(VulkanContext::GetLogicalDevice(), m_Frames[i].Pool, 0, MaxScopes * 2);
+			}
+
+			if (!m_Track) m_Track = &Profiler::Get().AddTrack("GPU", "gpu");
+		}
+
+		void Destroy()
+		{
+			for (auto& frame : m_Frames)
+			{
+				if (frame.Pool) vkDestroyQueryPool(VulkanContext::GetLogicalDevice(), frame.Pool, VulkanContext::GetAllocator());
+				frame = {};
+			}
+			m_Timings.clear();
+			m_FrameTiming = {};
+		}
+
+		// Reads the results CURRENT_FRAME's pool holds from its last use and resets it. Call after the render fence,
+		// before the first scope. The fence means no queue still writes to the pool, so the host reset needs no barrier
+		void BeginFrame()
+		{
+			Frame& frame = m_Frames[CURRENT_FRAME];
+			if (m_Supported && !frame.Scopes.empty())
+			{
+				uint64_t timestamps[MaxScopes * 2];
+				uint32_t queryCount = (uint32_t)frame.Scopes.size() * 2;
+
+				// Without VK_QUERY_RESULT_WAIT_BIT, a scope that was never ended leaves the frame VK_NOT_READY and it is skipped
+				VkResult result = vkGetQueryPoolResults(VulkanContext::GetLogicalDevice(), frame.Pool, 0, queryCount,
+					sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+				if (result == VK_SUCCESS) ReadTimings(frame, timestamps);
+
+				vkResetQueryPool(VulkanContext::GetLogicalDevice(), frame.Pool, 0, queryCount);
+			}
+
+			frame.Scopes.clear();
+			frame.Open.clear();
+		}
+
+		// Scopes may be recorded into command buffers of any queue, in any order
+		void Begin(VkCommandBuffer cmd, const char* name, const glm::vec4& color = glm::vec4(1.f))
+		{
+			VulkanContext::BeginLabel(cmd, name, color);
+
+			Frame& frame = m_Frames[CURRENT_FRAME];
+			if (!m_Supported || frame.Scopes.size() == MaxScopes)
+			{
+				frame.Open.push_back(UINT32_MAX);
+				return;
+			}
+
+			if (frame.Scopes.empty()) frame.RecordTime = Profiler::Get().Now();
+
+			uint32_t index = (uint32_t)frame.Scopes.size();
+			frame.Scopes.push_back({ name, (uint32_t)frame.Open.size() });
+			frame.Open.push_back(index);
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.Pool, index * 2);
+		}
+
+		void End(VkCommandBuffer cmd)
+		{
+			Frame& frame = m_Frames[CURRENT_FRAME];
+			uint32_t index = frame.Open.back();
+			frame.Open.pop_back();
+			if (index != UINT32_MAX) vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.Pool, index * 2 + 1);
+
+			VulkanContext::EndLabel(cmd);
+		}
+
+		// In the order the scopes were begun, FRAME_OVERLAP frames behind
+		const auto& GetTimings() const { return m_Timings; }
+
+		// From the earliest begin to the latest end of all scopes. Passes on different queues overlap,
+		// so this is the GPU frame time and not the sum of the top level scopes
+		const Timing& GetFrameTiming() const { return m_FrameTiming; }
+	private:
+		struct Scope
+		{
+			const char* Name;
+			uint32_t Depth;
+		};
+
+		struct Frame
+		{
+			VkQueryPool Pool = VK_NULL_HANDLE;
+			std::vector<Scope> Scopes; // Scope i owns queries 2i (begin) and 2i + 1 (end)
+			std::vector<uint32_t> Open; // Scopes begun but not ended yet, UINT32_MAX for ones without queries
+			int64_t RecordTime = 0; // Profiler time when the first scope was recorded
+		};
+
+		void ReadTimings(const Frame& frame, const uint64_t* timestamps)
+		{
+			m_Timings.resize(frame.Scopes.size());
+
+			// The GPU clock has no relation to the CPU one, so the trace puts the earliest timestamp at the time the
+			// frame's first scope was recorded. Durations and the gaps between passes are exact, the offset is not
+			uint64_t first = UINT64_MAX, last = 0;
+			for (size_t i = 0; i < frame.Scopes.size(); i++)
+			{
+				first = std::min(first, timestamps[i * 2]);
+				last = std::max(last, timestamps[i * 2 + 1]);
+			}
+			bool record = m_Track && Profiler::Get().IsRecording();
+
+			for (size_t i = 0; i < frame.Scopes.size(); i++)
+			{
+				const Scope& scope = frame.Scopes[i];
+				double start = double(timestamps[i * 2] - first) * m_TimestampPeriod;
+				double duration = double(timestamps[i * 2 + 1] - timestamps[i * 2]) * m_TimestampPeriod;
+				float milliseconds = float(duration * 1e-6);
+
+				Timing& timing = m_Timings[i];
+				if (timing.Name != scope.Name) timing.Average = milliseconds;
+				timing.Name = scope.Name;
+				timing.Depth = scope.Depth;
+				timing.Milliseconds = milliseconds;
+				timing.Average += (milliseconds - timing.Average) * 0.05f;
+
+				if (record) Profiler::Get().Record(*m_Track, scope.Name, frame.RecordTime + int64_t(start), frame.RecordTime + int64_t(start + duration));
+			}
+
+			float frameMilliseconds = float(double(last - first) * m_TimestampPeriod * 1e-6);
+			if (!m_FrameTiming.Name) m_FrameTiming = { "Frame", 0, frameMilliseconds, frameMilliseconds };
+			m_FrameTiming.Milliseconds = frameMilliseconds;
+			m_FrameTiming.Average += (frameMilliseconds - m_FrameTiming.Average) * 0.05f;
+		}
+
+		Frame m_Frames[FRAME_OVERLAP];
+		std::vector<Timing> m_Timings;
+		Timing m_FrameTiming;
+
+		bool m_Supported = false;
+		float m_TimestampPeriod = 1.f; // Nanoseconds per tick
+		Profiler::Track* m_Track = nullptr;
+	};
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <wc/vk/Buffer.h>
+#include <wc/vk/SyncContext.h>
+
+namespace wc
+{
+	// Host visible buffer that stays mapped for its whole lifetime. VMA_MEMORY_USAGE_CPU_TO_GPU prefers
+	// device local memory, so with resizable BAR the shaders read it without a PCIe round trip
+	class MappedBuffer : public VkObject<VkBuffer>
+	{
+		VmaAllocation m_Allocation = VK_NULL_HANDLE;
+		void* m_Data = nullptr;
+	public:
+
+		void Allocate(VkDeviceSize bufferSize, uint32_t usage = wc::STORAGE_BUFFER)
+		{
+			VkBufferCreateInfo bufferInfo = {
+				.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+				.size = bufferSize,
+				.usage = usage,
+			};
+
+			VmaAllocationCreateInfo vmaallocInfo = {};
+			vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+			vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+			VmaAllocationInfo allocationInfo = {};
+			vmaCreateBuffer(VulkanContext::GetMemoryAllocator(), &bufferInfo, &vmaallocInfo, &m_RendererID, &m_Allocation, &allocationInfo);
+			m_Data = allocationInfo.pMappedData;
+		}
+
+		void* GetData() const { return m_Data; }
+
+		// Makes host writes visible to the device, a no-op on host coherent memory
+		void Flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) { vmaFlushAllocation(VulkanContext::GetMemoryAllocator(), m_Allocation, offset, size); }
+
+		void Free()
+		{
+			vmaDestroyBuffer(VulkanContext::GetMemoryAllocator(), m_RendererID, m_Allocation);
+			m_RendererID = VK_NULL_HANDLE;
+			m_Allocation = VK_NULL_HANDLE;
+			m_Data = nullptr;
+		}
+
+		VkDescriptorBufferInfo GetDescriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const
+		{
+			VkDescriptorBufferInfo info;
+			info.buffer = m_RendererID;
+			info.offset = offset;
+			info.range = size;
+			return info;
+		}
+	};
+
+	// One mapped buffer per frame in flight. Writes always go to the buffer of CURRENT_FRAME, which the
+	// render fence guarantees the GPU is done with, so nothing has to be copied or waited on
+	template<typename T>
+	struct FrameRingBuffer
+	{
+	private:
+		MappedBuffer m_Buffers[FRAME_OVERLAP];
+	public:
+		uint32_t Counter = 0;
+
+	public:
+		const MappedBuffer& GetBuffer(uint32_t frame = CURRENT_FRAME) const { return m_Buffers[frame]; }
+
+		void Allocate(uint32_t elements, uint32_t usage = wc::STORAGE_BUFFER)
+		{
+			for (auto& buffer : m_Buffers) buffer.Allocate(elements * sizeof(T), usage);
+		}
+
+		void Flush() { if (Counter) m_Buffers[CURRENT_FRAME].Flush(Counter * sizeof(T)); }
+
+		void Free()
+		{
+			Counter = 0;
+			for (auto& buffer : m_Buffers) buffer.Free();
+		}
+
+		void SetName(const std::string& name)
+		{
+			for (uint32_t i = 0; i < FRAME_OVERLAP; i++) m_Buffers[i].SetName(std::format("{}[{}]", name, i));
+		}
+
+		inline operator T* () const { return (T*)m_Buffers[CURRENT_FRAME].GetData(); }
+	};
+}
\ No newline at end of file
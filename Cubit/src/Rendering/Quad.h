@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define WC_QUAD_SSE 1
+#include <immintrin.h>
+#endif
+
+namespace wc
+{
+	enum QuadFlags : uint8_t
+	{
+		QUAD_CIRCLE = 1 << 0,   // Params hold thickness and fade, texture coordinates span [-1, 1]
+		QUAD_MSDF = 1 << 1,     // Text and SVG images, the texture is a multi-channel distance field
+		QUAD_UV_RECT = 1 << 2,  // UV selects a sub rectangle of the texture
+		QUAD_TRIANGLE = 1 << 3, // Only the first three corners of the unit triangle are used
+	};
+
+	// One record per quad, the vertex shader expands the corners from gl_VertexIndex (see Quad.glsl).
+	// Corners are Center +- AxisX / 2 +- AxisY / 2, in clip space for batches and world space for tile meshes
+	struct QuadInstance
+	{
+		glm::vec2 Center;
+		glm::vec2 AxisX;
+		glm::vec2 AxisY;
+		uint32_t Color[2];  // RGBA as halfs, colors go above 1 for bloom
+		uint32_t UV[2];     // Min and max texture coordinates as unorm16 pairs, only with QUAD_UV_RECT
+		uint16_t TextureID;
+		uint8_t Flags;
+		uint8_t _pad = 0;
+		uint32_t Params;    // Thickness and fade as halfs, only with QUAD_CIRCLE
+
+		void SetColor(const glm::vec4& color)
+		{
+			Color[0] = glm::packHalf2x16({ color.r, color.g });
+			Color[1] = glm::packHalf2x16({ color.b, color.a });
+		}
+
+		void SetUV(glm::vec2 min, glm::vec2 max)
+		{
+			UV[0] = glm::packUnorm2x16(min);
+			UV[1] = glm::packUnorm2x16(max);
+		}
+	};
+	static_assert(sizeof(QuadInstance) == 48, "QuadInstance has to match the std430 layout in Quad.glsl");
+
+	// Input of RenderData::DrawQuads, the layout is fixed so the SIMD kernel can load it in 16 byte rows
+	struct QuadDesc
+	{
+		glm::vec3 Position;
+		float Rotation = 0.f; // Radians
+		glm::vec2 Size = glm::vec2(1.f);
+		uint32_t TextureID = 0;
+		uint32_t _pad = 0;
+		glm::vec4 Color = glm::vec4(1.f);
+	};
+	static_assert(sizeof(QuadDesc) == 48, "WriteQuads loads QuadDesc as three 16 byte rows");
+
+	// Writes one textured quad, viewProjection has to be affine (orthographic)
+	inline void WriteQuad(const QuadDesc& desc, const glm::mat4& viewProjection, QuadInstance& quad)
+	{
+		glm::vec2 a = glm::vec2(viewProjection[0]);
+		glm::vec2 b = glm::vec2(viewProjection[1]);
+
+		float c = 1.f;
+		float s = 0.f;
+		if (desc.Rotation != 0.f)
+		{
+			c = glm::cos(desc.Rotation);
+			s = glm::sin(desc.Rotation);
+		}
+
+		quad.Center = glm::vec2(viewProjection[3]) + a * desc.Position.x + b * desc.Position.y + glm::vec2(viewProjection[2]) * desc.Position.z;
+		quad.AxisX = (a * c + b * s) * desc.Size.x;
+		quad.AxisY = (b * c - a * s) * desc.Size.y;
+		quad.SetColor(desc.Color);
+		quad.TextureID = (uint16_t)desc.TextureID;
+		quad.Flags = 0;
+	}
+
+	inline void WriteQuadsScalar(const QuadDesc* descs, uint32_t count, const glm::mat4& viewProjection, QuadInstance* quads)
+	{
+		for (uint32_t i = 0; i < count; i++) WriteQuad(descs[i], viewProjection, quads[i]);
+	}
+
+#ifdef WC_QUAD_SSE
+	namespace QuadSSE
+	{
+		// sin and cos of 4 angles: quadrant reduction, then Taylor polynomials on [-pi/4, pi/4], error below 1e-6
+		inline void SinCos(__m128 x, __m128& s, __m128& c)
+		{
+			__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f))); // Round to the nearest quadrant
+			__m128 qf = _mm_cvtepi32_ps(q);
+
+			// Cody-Waite: pi/2 split in two parts so the reduction stays exact for large angles
+			__m128 r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(1.5703125f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(4.83826794897e-4f)));
+			__m128 r2 = _mm_mul_ps(r, r);
+
+			__m128 sr = _mm_add_ps(_mm_set1_ps(-1.f / 5040.f), _mm_mul_ps(r2, _mm_set1_ps(1.f / 362880.f)));
+			sr = _mm_add_ps(_mm_set1_ps(1.f / 120.f), _mm_mul_ps(r2, sr));
+			sr = _mm_add_ps(_mm_set1_ps(-1.f / 6.f), _mm_mul_ps(r2, sr));
+			sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r2, r), sr));
+
+			__m128 cr = _mm_add_ps(_mm_set1_ps(-1.f / 720.f), _mm_mul_ps(r2, _mm_set1_ps(1.f / 40320.f)));
+			cr = _mm_add_ps(_mm_set1_ps(1.f / 24.f), _mm_mul_ps(r2, cr));
+			cr = _mm_add_ps(_mm_set1_ps(-0.5f), _mm_mul_ps(r2, cr));
+			cr = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(r2, cr));
+
+			// Odd quadrants swap sin and cos, the sign comes from bit 1 of q (q + 1 for cos)
+			__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+			__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+			__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+			s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr)), sinSign);
+			c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr)), cosSign);
+		}
+
+		// SSE2 float to half with round to nearest even. Results below the normal half range flush to zero
+		// and NaN is not handled, which is fine for colors
+		inline __m128i FloatToHalf(__m128 value)
+		{
+			__m128i bits = _mm_castps_si128(value);
+			__m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+			__m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+
+			__m128i round = _mm_add_epi32(_mm_set1_epi32(0xFFF), _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1)));
+			__m128i half = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(magnitude, round), 13), _mm_set1_epi32(112 << 10)); // Rebias 127 -> 15
+
+			__m128i underflow = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(0x38800000)); // 2^-14
+			__m128i overflow = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x477FEFFF));  // Rounds to 65536 or more
+			half = _mm_andnot_si128(underflow, half);
+			half = _mm_or_si128(_mm_andnot_si128(overflow, half), _mm_and_si128(overflow, _mm_set1_epi32(0x7C00)));
+			half = _mm_or_si128(half, sign);
+
+			// Sign extend so the saturating pack keeps the 16 bit patterns
+			half = _mm_srai_epi32(_mm_slli_epi32(half, 16), 16);
+			return _mm_packs_epi32(half, half);
+		}
+
+		inline void StoreColor(const glm::vec4& color, QuadInstance& quad)
+		{
+#if defined(__F16C__) || defined(__AVX2__)
+			_mm_storel_epi64((__m128i*)quad.Color, _mm_cvtps_ph(_mm_loadu_ps(&color.x), _MM_FROUND_TO_NEAREST_INT));
+#else
+			_mm_storel_epi64((__m128i*)quad.Color, FloatToHalf(_mm_loadu_ps(&color.x)));
+#endif
+		}
+	}
+#endif
+
+	// Writes count textured quads, 4 at a time with SSE. Rotations are skipped for groups that are all axis aligned
+	inline void WriteQuads(const QuadDesc* descs, uint32_t count, const glm::mat4& viewProjection, QuadInstance* quads)
+	{
+		uint32_t i = 0;
+#ifdef WC_QUAD_SSE
+		const __m128 ax = _mm_set1_ps(viewProjection[0].x), ay = _mm_set1_ps(viewProjection[0].y);
+		const __m128 bx = _mm_set1_ps(viewProjection[1].x), by = _mm_set1_ps(viewProjection[1].y);
+		const __m128 zx = _mm_set1_ps(viewProjection[2].x), zy = _mm_set1_ps(viewProjection[2].y);
+		const __m128 tx = _mm_set1_ps(viewProjection[3].x), ty = _mm_set1_ps(viewProjection[3].y);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const float* src = &descs[i].Position.x;
+			constexpr uint32_t stride = sizeof(QuadDesc) / sizeof(float);
+
+			// Position + Rotation and Size + TextureID rows, transposed into one register per field
+			__m128 px = _mm_loadu_ps(src), py = _mm_loadu_ps(src + stride), pz = _mm_loadu_ps(src + stride * 2), rot = _mm_loadu_ps(src + stride * 3);
+			_MM_TRANSPOSE4_PS(px, py, pz, rot);
+
+			__m128 w = _mm_loadu_ps(src + 4), h = _mm_loadu_ps(src + stride + 4), t0 = _mm_loadu_ps(src + stride * 2 + 4), t1 = _mm_loadu_ps(src + stride * 3 + 4);
+			_MM_TRANSPOSE4_PS(w, h, t0, t1);
+
+			__m128 s = _mm_setzero_ps();
+			__m128 c = _mm_set1_ps(1.f);
+			if (_mm_movemask_ps(_mm_cmpneq_ps(rot, _mm_setzero_ps()))) QuadSSE::SinCos(rot, s, c);
+
+			__m128 cx = _mm_add_ps(_mm_add_ps(tx, _mm_mul_ps(ax, px)), _mm_add_ps(_mm_mul_ps(bx, py), _mm_mul_ps(zx, pz)));
+			__m128 cy = _mm_add_ps(_mm_add_ps(ty, _mm_mul_ps(ay, px)), _mm_add_ps(_mm_mul_ps(by, py), _mm_mul_ps(zy, pz)));
+
+			__m128 axisXx = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ax, c), _mm_mul_ps(bx, s)), w);
+			__m128 axisXy = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ay, c), _mm_mul_ps(by, s)), w);
+			__m128 axisYx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(bx, c), _mm_mul_ps(ax, s)), h);
+			__m128 axisYy = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(by, c), _mm_mul_ps(ay, s)), h);
+
+			// Back to one row per quad: [Center, AxisX] and [AxisY]
+			_MM_TRANSPOSE4_PS(cx, cy, axisXx, axisXy);
+			__m128 axisY01 = _mm_unpacklo_ps(axisYx, axisYy);
+			__m128 axisY23 = _mm_unpackhi_ps(axisYx, axisYy);
+
+			QuadInstance* dst = quads + i;
+			_mm_storeu_ps(&dst[0].Center.x, cx);
+			_mm_storeu_ps(&dst[1].Center.x, cy);
+			_mm_storeu_ps(&dst[2].Center.x, axisXx);
+			_mm_storeu_ps(&dst[3].Center.x, axisXy);
+			_mm_storel_pi((__m64*)&dst[0].AxisY.x, axisY01);
+			_mm_storeh_pi((__m64*)&dst[1].AxisY.x, axisY01);
+			_mm_storel_pi((__m64*)&dst[2].AxisY.x, axisY23);
+			_mm_storeh_pi((__m64*)&dst[3].AxisY.x, axisY23);
+
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				QuadSSE::StoreColor(descs[i + j].Color, dst[j]);
+				dst[j].TextureID = (uint16_t)descs[i + j].TextureID;
+				dst[j].Flags = 0;
+			}
+		}
+#endif
+		WriteQuadsScalar(descs + i, count - i, viewProjection, quads + i);
+	}
+}
\ No newline at end of file
@@ -5,36 +5,26 @@
 #include <wc/vk/Images.h>
 #include <wc/Texture.h>
 
+#include <span>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <wc/Utils/CPUImage.h>
+#include "../Profiler.h"
+#include "Culling.h"
 #include "Font.h"
+#include "MappedBuffer.h"
+#include "Quad.h"
 
 #undef LoadImage
 namespace wc
 {
+	// Sizes of a single batch, RenderData opens another batch when one fills up
 	static const uint32_t MaxQuadCount = 10'000;
-	static const uint32_t MaxQuadVertexCount = MaxQuadCount * 4;
-	static const uint32_t MaxQuadIndexCount = MaxQuadCount * 6;
 
 	static const uint32_t MaxLineCount = 20'000;
 	static const uint32_t MaxLineVertexCount = MaxLineCount * 2;
 
-	struct Vertex
-	{
-		glm::vec3 Position;
-		uint32_t TextureID = 0;
-		glm::vec2 TexCoords;
-		float Fade = 0.f;
-		float Thickness = 0.f;
-
-		glm::vec4 Color;
-		Vertex() = default;
-		Vertex(const glm::vec3& pos, glm::vec2 texCoords, uint32_t texID, const glm::vec4& color) : Position(pos), TexCoords(texCoords), TextureID(texID), Color(color) {}
-		Vertex(const glm::vec3& pos, glm::vec2 texCoords, float thickness, float fade, const glm::vec4& color) : Position(pos), TexCoords(texCoords), Thickness(thickness), Fade(fade), Color(color) {}
-	};
-
 	struct LineVertex
 	{
 		glm::vec3 Position;
@@ -45,52 +35,90 @@ namespace wc
 		LineVertex(const glm::vec3& pos, const glm::vec4& color) : Position(pos), Color(color) {}
 	};
 
+	struct QuadBatch
+	{
+		FrameRingBuffer<QuadInstance> Quads;
+	};
+
+	// Pre-built geometry living in its own GPU buffer, drawn by Renderer2D with the tile shader
+	struct TileMeshDraw
+	{
+		glm::mat4 ViewProjection;
+		VkDeviceAddress Quads = 0;
+		uint32_t QuadCount = 0;
+	};
+
+	// World space quads written by a compute shader, the vertex count comes from a VkDrawIndirectCommand
+	struct IndirectQuadDraw
+	{
+		glm::mat4 ViewProjection;
+		VkDeviceAddress Quads = 0;
+		VkBuffer DrawCommand = VK_NULL_HANDLE;
+	};
+
 	struct RenderData
 	{
 	private:
-		BufferManager<Vertex> m_VertexBuffer;
-		BufferManager<uint32_t> m_IndexBuffer;
-		BufferManager<LineVertex> m_LineVertexBuffer;
+		// Batches are kept between frames, only the ones up to the current index hold data
+		std::vector<QuadBatch> m_Batches;
+		uint32_t m_BatchIndex = 0;
+
+		std::vector<FrameRingBuffer<LineVertex>> m_LineBatches;
+		uint32_t m_LineBatchIndex = 0;
 
 		std::unordered_map<std::string, uint32_t> m_Cache;
+
+		std::vector<TileMeshDraw> m_TileMeshes;
+		uint32_t m_TileLayerBatch = 0; // Quads submitted before the first tile mesh are drawn below the tiles
+		uint32_t m_TileLayerIndex = 0;
+
+		std::vector<IndirectQuadDraw> m_IndirectDraws;
 	public:
 		std::vector<Texture> Textures;
 
 		glm::mat4 ViewProjection = glm::mat4(1.f);
+
+		CullRect View; // Set by the caller together with ViewProjection, draws outside of it should be skipped
+		CullingStats Culling;
+		CullingStats LastCulling; // Culling of the previous frame, Culling is cleared by Reset
 	public:
-		auto GetVertexBuffer() const { return m_VertexBuffer.GetBuffer(); }
-		auto GetIndexBuffer() const { return m_IndexBuffer.GetBuffer(); }
+		// Number of batches allocated so far, Renderer2D keeps one descriptor set per batch
+		uint32_t GetBatchCount() const { return (uint32_t)m_Batches.size(); }
+		// Number of batches holding data this frame
+		uint32_t GetUsedBatchCount() const { return m_Batches[m_BatchIndex].Quads.Counter ? m_BatchIndex + 1 : m_BatchIndex; }
+		const QuadBatch& GetBatch(uint32_t batch) const { return m_Batches[batch]; }
 
-		auto GetLineVertexBuffer() const { return m_LineVertexBuffer.GetBuffer(); }
+		uint32_t GetLineBatchCount() const { return (uint32_t)m_LineBatches.size(); }
+		uint32_t GetUsedLineBatchCount() const { return m_LineBatches[m_LineBatchIndex].Counter ? m_LineBatchIndex + 1 : m_LineBatchIndex; }
+		const auto& GetLineBatch(uint32_t batch) const { return m_LineBatches[batch]; }
 
-		auto GetIndexCount() const { return m_IndexBuffer.Counter; }
-		auto GetVertexCount() const { return m_VertexBuffer.Counter; }
+		const auto& GetTileMeshes() const { return m_TileMeshes; }
+		auto GetTileLayerBatch() const { return m_TileLayerBatch; }
+		auto GetTileLayerIndex() const { return m_TileLayerIndex; }
 
-		auto GetLineVertexCount() const { return m_LineVertexBuffer.Counter; }
+		const auto& GetIndirectDraws() const { return m_IndirectDraws; }
 
-		void UploadVertexData()
+		// The batches are written in place, this only makes the writes visible on non-coherent memory
+		void FlushVertexData()
 		{
-			SyncContext::immediate_submit([=](VkCommandBuffer cmd) {
-				m_IndexBuffer.Update(cmd);
-				m_VertexBuffer.Update(cmd);
-				});
+			WC_PROFILE_SCOPE("RenderData::FlushVertexData");
+
+			for (uint32_t i = 0; i < GetUsedBatchCount(); i++)
+				m_Batches[i].Quads.Flush();
 		}
 
-		void UploadLineVertexData()
+		void FlushLineVertexData()
 		{
-			SyncContext::immediate_submit([=](VkCommandBuffer cmd) {
-				m_LineVertexBuffer.Update(cmd);
-				});
+			WC_PROFILE_SCOPE("RenderData::FlushLineVertexData");
+
+			for (uint32_t i = 0; i < GetUsedLineBatchCount(); i++)
+				m_LineBatches[i].Flush();
 		}
 
 		void Create()
 		{
-			m_IndexBuffer.Allocate(MaxQuadIndexCount, INDEX_BUFFER);
-			m_VertexBuffer.Allocate(MaxQuadVertexCount);
-
-			m_LineVertexBuffer.Allocate(MaxLineVertexCount);
-
-			m_LineVertexBuffer.GetBuffer().SetName("LineVertexBuffer");
+			AllocateBatch();
+			AllocateLineBatch();
 
 			Texture texture;
 			uint32_t white = 0xFFFFFFFF;
@@ -136,69 +164,38 @@ namespace wc
 			return uint32_t(Textures.size() - 1);
 		}
 
-		void DrawMesh(const Vertex* pVertices, uint32_t vCount, const uint32_t* pIndices, uint32_t iCount)
+		// quads points to QuadCount world space quad instances already on the GPU
+		void DrawTileMesh(VkDeviceAddress quads, uint32_t quadCount)
 		{
+			if (m_TileMeshes.empty())
+			{
+				m_TileLayerBatch = m_BatchIndex;
+				m_TileLayerIndex = m_Batches[m_BatchIndex].Quads.Counter;
+			}
 
+			auto& draw = m_TileMeshes.emplace_back();
+			draw.ViewProjection = ViewProjection;
+			draw.Quads = quads;
+			draw.QuadCount = quadCount;
 		}
 
-		void DrawQuad(glm::mat4 transform, uint32_t texID, const glm::vec4& color = glm::vec4(1.f))
+		// Drawn after all batches, drawCommand has to be filled in before the frame is submitted
+		void DrawQuadsIndirect(VkDeviceAddress quads, VkBuffer drawCommand)
 		{
-			if (m_IndexBuffer.Counter >= MaxQuadIndexCount) WC_CORE_ERROR("Not enough memory");// Flush();
-
-			Vertex* vertices = m_VertexBuffer;
-			auto& vertCount = m_VertexBuffer.Counter;
-
-			uint32_t* indices = m_IndexBuffer;
-			auto& indexCount = m_IndexBuffer.Counter;
-
-			transform = ViewProjection * transform;
-
-			vertices[vertCount + 0] = Vertex(transform * glm::vec4(0.5f, 0.5f, 0.f, 1.f), { 1.f, 0.f }, texID, color);
-			vertices[vertCount + 1] = Vertex(transform * glm::vec4(-0.5f, 0.5f, 0.f, 1.f), { 0.f, 0.f }, texID, color);
-			vertices[vertCount + 2] = Vertex(transform * glm::vec4(-0.5f, -0.5f, 0.f, 1.f), { 0.f, 1.f }, texID, color);
-			vertices[vertCount + 3] = Vertex(transform * glm::vec4(0.5f, -0.5f, 0.f, 1.f), { 1.f, 1.f }, texID, color);
-
-			indices[indexCount + 0] = vertCount;
-			indices[indexCount + 1] = 1 + vertCount;
-			indices[indexCount + 2] = 2 + vertCount;
-
-			indices[indexCount + 3] = 2 + vertCount;
-			indices[indexCount + 4] = 3 + vertCount;
-			indices[indexCount + 5] = vertCount;
+			auto& draw = m_IndirectDraws.emplace_back();
+			draw.ViewProjection = ViewProjection;
+			draw.Quads = quads;
+			draw.DrawCommand = drawCommand;
+		}
 
-			vertCount += 4;
-			indexCount += 6;
+		void DrawQuad(glm::mat4 transform, uint32_t texID, const glm::vec4& color = glm::vec4(1.f))
+		{
+			PushQuad(ViewProjection * transform, glm::vec2(0.f), glm::vec2(1.f), texID, color, 0);
 		}
 
 		void DrawQuadSvg(glm::mat4 transform, uint32_t texID, const glm::vec4& color = glm::vec4(1.f))
 		{
-			if (m_IndexBuffer.Counter >= MaxQuadIndexCount) WC_CORE_ERROR("Not enough memory");// Flush();
-
-			Vertex* vertices = m_VertexBuffer;
-			auto& vertCount = m_VertexBuffer.Counter;
-
-			uint32_t* indices = m_IndexBuffer;
-			auto& indexCount = m_IndexBuffer.Counter;
-
-			transform = ViewProjection * transform;
-
-			vertices[vertCount + 0] = Vertex(transform * glm::vec4(0.5f, 0.5f, 0.f, 1.f), { 1.f, 0.f }, texID, color);
-			vertices[vertCount + 1] = Vertex(transform * glm::vec4(-0.5f, 0.5f, 0.f, 1.f), { 0.f, 0.f }, texID, color);
-			vertices[vertCount + 2] = Vertex(transform * glm::vec4(-0.5f, -0.5f, 0.f, 1.f), { 0.f, 1.f }, texID, color);
-			vertices[vertCount + 3] = Vertex(transform * glm::vec4(0.5f, -0.5f, 0.f, 1.f), { 1.f, 1.f }, texID, color);
-
-			for (uint32_t i = 0; i < 4; i++) vertices[vertCount + i].Thickness = -1.f;
-
-			indices[indexCount + 0] = vertCount;
-			indices[indexCount + 1] = 1 + vertCount;
-			indices[indexCount + 2] = 2 + vertCount;
-
-			indices[indexCount + 3] = 2 + vertCount;
-			indices[indexCount + 4] = 3 + vertCount;
-			indices[indexCount + 5] = vertCount;
-
-			vertCount += 4;
-			indexCount += 6;
+			PushQuad(ViewProjection * transform, glm::vec2(0.f), glm::vec2(1.f), texID, color, QUAD_MSDF);
 		}
 
 		void DrawLineQuad(glm::mat4 transform, const glm::vec4& color = glm::vec4(1.f))
@@ -216,39 +213,38 @@ namespace wc
 
 		void DrawQuad(const glm::vec3& position, glm::vec2 size, uint32_t texID = 0, const glm::vec4& color = glm::vec4(1.f))
 		{
-			glm::mat4 transform = glm::translate(glm::mat4(1.f), position) * glm::scale(glm::mat4(1.f), { size.x, size.y, 1.f });
-			DrawQuad(transform, texID, color);
+			WriteQuad({ .Position = position, .Size = size, .TextureID = texID, .Color = color }, ViewProjection, NextQuad());
 		}
 
 		// Note: Rotation should be in radians
 		void DrawQuad(const glm::vec3& position, glm::vec2 size, float rotation, uint32_t texID = 0, const glm::vec4& color = glm::vec4(1.f))
 		{
-			glm::mat4 transform = glm::translate(glm::mat4(1.f), position) * glm::rotate(glm::mat4(1.f), rotation, { 0.f, 0.f, 1.f }) * glm::scale(glm::mat4(1.f), { size.x, size.y, 1.f });
-			DrawQuad(transform, texID, color);
+			WriteQuad({ .Position = position, .Rotation = rotation, .Size = size, .TextureID = texID, .Color = color }, ViewProjection, NextQuad());
 		}
 
-		void DrawTriangle(glm::mat4 transform, uint32_t texID, const glm::vec4& color = glm::vec4(1.f))
+		// Same as calling DrawQuad(position, size, rotation, ...) for every element, but goes through the SIMD kernel
+		void DrawQuads(std::span<const QuadDesc> quads)
 		{
-			if (m_IndexBuffer.Counter >= MaxQuadIndexCount) WC_CORE_ERROR("Not enough memory");// Flush();
-
-			Vertex* vertices = m_VertexBuffer;
-			auto& vertCount = m_VertexBuffer.Counter;
-
-			uint32_t* indices = m_IndexBuffer;
-			auto& indexCount = m_IndexBuffer.Counter;
-
-			transform = ViewProjection * transform;
+			while (!quads.empty())
+			{
+				auto* batch = &m_Batches[m_BatchIndex].Quads;
+				if (batch->Counter == MaxQuadCount)
+				{
+					if (++m_BatchIndex == m_Batches.size()) AllocateBatch();
+					batch = &m_Batches[m_BatchIndex].Quads;
+				}
 
-			vertices[vertCount + 0] = Vertex(transform * glm::vec4(-0.5f, -0.5f, 0.f, 1.f), { 1.f, 0.f }, texID, color);
-			vertices[vertCount + 1] = Vertex(transform * glm::vec4(0.5f, -0.5f, 0.f, 1.f), { 0.f, 0.f }, texID, color);
-			vertices[vertCount + 2] = Vertex(transform * glm::vec4(0.f, 0.5f, 0.f, 1.f), { 0.f, 1.f }, texID, color);
+				uint32_t count = glm::min((uint32_t)quads.size(), MaxQuadCount - batch->Counter);
+				WriteQuads(quads.data(), count, ViewProjection, (QuadInstance*)*batch + batch->Counter);
+				batch->Counter += count;
 
-			indices[indexCount + 0] = vertCount;
-			indices[indexCount + 1] = 1 + vertCount;
-			indices[indexCount + 2] = 2 + vertCount;
+				quads = quads.subspan(count);
+			}
+		}
 
-			vertCount += 3;
-			indexCount += 3;
+		void DrawTriangle(glm::mat4 transform, uint32_t texID, const glm::vec4& color = glm::vec4(1.f))
+		{
+			PushQuad(ViewProjection * transform, glm::vec2(0.f), glm::vec2(1.f), texID, color, QUAD_TRIANGLE);
 		}
 
 		void DrawTriangle(const glm::vec3& position, glm::vec2 size, float rotation, uint32_t texID = 0, const glm::vec4& color = glm::vec4(1.f))
@@ -259,73 +255,48 @@ namespace wc
 
 		void DrawCircle(glm::mat4 transform, float thickness = 1.f, float fade = 0.05f, const glm::vec4& color = glm::vec4(1.f))
 		{
-			Vertex* vertices = m_VertexBuffer;
-			auto& vertCount = m_VertexBuffer.Counter;
-
-			uint32_t* indices = m_IndexBuffer;
-			auto& indexCount = m_IndexBuffer.Counter;
-
-			transform = ViewProjection * transform;
-
-			vertices[vertCount + 0] = Vertex(transform * glm::vec4(1.f, 1.f, 0.f, 1.f), { 1.f, 1.f }, thickness, fade, color);
-			vertices[vertCount + 1] = Vertex(transform * glm::vec4(-1.f, 1.f, 0.f, 1.f), { -1.f, 1.f }, thickness, fade, color);
-			vertices[vertCount + 2] = Vertex(transform * glm::vec4(-1.f, -1.f, 0.f, 1.f), { -1.f,-1.f }, thickness, fade, color);
-			vertices[vertCount + 3] = Vertex(transform * glm::vec4(1.f, -1.f, 0.f, 1.f), { 1.f,-1.f }, thickness, fade, color);
-
-			indices[indexCount + 0] = vertCount;
-			indices[indexCount + 1] = 1 + vertCount;
-			indices[indexCount + 2] = 2 + vertCount;
-
-			indices[indexCount + 3] = 2 + vertCount;
-			indices[indexCount + 4] = 3 + vertCount;
-			indices[indexCount + 5] = vertCount;
-
-			vertCount += 4;
-			indexCount += 6;
+			auto& quad = PushQuad(ViewProjection * transform, glm::vec2(0.f), glm::vec2(2.f), 0, color, QUAD_CIRCLE);
+			quad.Params = glm::packHalf2x16({ thickness, fade });
 		}
 
 		void DrawCircle(glm::vec3 position, float radius, float thickness = 1.f, float fade = 0.05f, const glm::vec4& color = glm::vec4(1.f))
 		{
-			Vertex* vertices = m_VertexBuffer;
-			auto& vertCount = m_VertexBuffer.Counter;
-
-			uint32_t* indices = m_IndexBuffer;
-			auto& indexCount = m_IndexBuffer.Counter;
-
-			auto transform = ViewProjection * glm::translate(glm::mat4(1.f), position) * glm::scale(glm::mat4(1.f), { radius, radius, 1.f });
-
-			vertices[vertCount + 0] = Vertex(transform * glm::vec4(1.f, 1.f, 0.f, 1.f), { 1.f, 1.f }, thickness, fade, color);
-			vertices[vertCount + 1] = Vertex(transform * glm::vec4(-1.f, 1.f, 0.f, 1.f), { -1.f, 1.f }, thickness, fade, color);
-			vertices[vertCount + 2] = Vertex(transform * glm::vec4(-1.f, -1.f, 0.f, 1.f), { -1.f,-1.f }, thickness, fade, color);
-			vertices[vertCount + 3] = Vertex(transform * glm::vec4(1.f, -1.f, 0.f, 1.f), { 1.f,-1.f }, thickness, fade, color);
-
-			indices[indexCount + 0] = vertCount;
-			indices[indexCount + 1] = 1 + vertCount;
-			indices[indexCount + 2] = 2 + vertCount;
-
-			indices[indexCount + 3] = 2 + vertCount;
-			indices[indexCount + 4] = 3 + vertCount;
-			indices[indexCount + 5] = vertCount;
-
-			vertCount += 4;
-			indexCount += 6;
+			auto& quad = NextQuad();
+			quad.Center = ToClip(position);
+			quad.AxisX = glm::vec2(ViewProjection[0]) * (2.f * radius);
+			quad.AxisY = glm::vec2(ViewProjection[1]) * (2.f * radius);
+			quad.SetColor(color);
+			quad.TextureID = 0;
+			quad.Flags = QUAD_CIRCLE;
+			quad.Params = glm::packHalf2x16({ thickness, fade });
 		}
 
 
 		void DrawLine(const glm::vec3& start, const glm::vec3& end, const glm::vec4& startColor, const glm::vec4& endColor)
 		{
-			//if (m_LineVertexCount >= MaxLineVertexCount) Flush();
+			auto& lines = ReserveLines(2);
 
-			m_LineVertexBuffer[m_LineVertexBuffer.Counter + 0] = LineVertex(ViewProjection * glm::vec4(start, 1.f), startColor);
-			m_LineVertexBuffer[m_LineVertexBuffer.Counter + 1] = LineVertex(ViewProjection * glm::vec4(end, 1.f), endColor);
+			lines[lines.Counter + 0] = LineVertex(ViewProjection * glm::vec4(start, 1.f), startColor);
+			lines[lines.Counter + 1] = LineVertex(ViewProjection * glm::vec4(end, 1.f), endColor);
 
-			m_LineVertexBuffer.Counter += 2;
+			lines.Counter += 2;
 		}
 
+		// Vertices are copied as they are, pairs may be split across batches
 		void DrawLines(const LineVertex* vertices, uint32_t count)
 		{
-			memcpy(m_LineVertexBuffer + m_LineVertexBuffer.Counter * sizeof(LineVertex), vertices, count * sizeof(LineVertex));
-			m_LineVertexBuffer.Counter += count;
+			count &= ~1u;
+			while (count)
+			{
+				auto& lines = ReserveLines(2);
+				uint32_t copyCount = glm::min(count, (MaxLineVertexCount - lines.Counter) & ~1u);
+
+				memcpy(lines + lines.Counter, vertices, copyCount * sizeof(LineVertex));
+				lines.Counter += copyCount;
+
+				vertices += copyCount;
+				count -= copyCount;
+			}
 		}
 
 		void DrawLine(const glm::vec3& start, const glm::vec3& end, const glm::vec3& startColor, const glm::vec3& endColor) { DrawLine(start, end, glm::vec4(startColor, 1.f), glm::vec4(endColor, 1.f)); }
@@ -339,12 +310,6 @@ namespace wc
 
 		void DrawString(const std::string& string, const Font& font, glm::mat4 transform, const glm::vec4& color = glm::vec4(1.f))
 		{
-			Vertex* vertices = m_VertexBuffer;
-			auto& vertCount = m_VertexBuffer.Counter;
-
-			uint32_t* indices = m_IndexBuffer;
-			auto& indexCount = m_IndexBuffer.Counter;
-
 			transform = ViewProjection * transform;
 
 			const auto& fontGeometry = font.FontGeometry;
@@ -419,23 +384,8 @@ namespace wc
 				texCoordMin *= glm::vec2(texelWidth, texelHeight);
 				texCoordMax *= glm::vec2(texelWidth, texelHeight);
 
-				vertices[vertCount + 0] = Vertex(transform * glm::vec4(quadMax, 0.f, 1.f), texCoordMax, texID, color);
-				vertices[vertCount + 1] = Vertex(transform * glm::vec4(quadMin.x, quadMax.y, 0.f, 1.f), { texCoordMin.x, texCoordMax.y }, texID, color);
-				vertices[vertCount + 2] = Vertex(transform * glm::vec4(quadMin, 0.f, 1.f), texCoordMin, texID, color);
-				vertices[vertCount + 3] = Vertex(transform * glm::vec4(quadMax.x, quadMin.y, 0.f, 1.f), { texCoordMax.x, texCoordMin.y }, texID, color);
-
-				for (uint32_t i = 0; i < 4; i++) vertices[vertCount + i].Thickness = -1.f;
-
-				indices[indexCount + 0] = vertCount;
-				indices[indexCount + 1] = 1 + vertCount;
-				indices[indexCount + 2] = 2 + vertCount;
-
-				indices[indexCount + 3] = 2 + vertCount;
-				indices[indexCount + 4] = 3 + vertCount;
-				indices[indexCount + 5] = vertCount;
-
-				vertCount += 4;
-				indexCount += 6;
+				auto& quad = PushQuad(transform, (quadMin + quadMax) * 0.5f, quadMax - quadMin, texID, color, QUAD_MSDF | QUAD_UV_RECT);
+				quad.SetUV(texCoordMin, texCoordMax);
 
 				if (i < string.size() - 1)
 				{
@@ -462,19 +412,86 @@ namespace wc
 
 		void Reset()
 		{
-			m_IndexBuffer.Counter = 0;
-			m_VertexBuffer.Counter = 0;
+			for (uint32_t i = 0; i <= m_BatchIndex; i++) m_Batches[i].Quads.Counter = 0;
+			m_BatchIndex = 0;
 
-			m_LineVertexBuffer.Counter = 0;
+			for (uint32_t i = 0; i <= m_LineBatchIndex; i++) m_LineBatches[i].Counter = 0;
+			m_LineBatchIndex = 0;
+
+			m_TileMeshes.clear();
+			m_TileLayerBatch = 0;
+			m_TileLayerIndex = 0;
+
+			m_IndirectDraws.clear();
+
+			LastCulling = Culling;
+			Culling = {};
+			View = {};
 		}
 
 		void Destroy()
 		{
-			m_VertexBuffer.Free();
-			m_IndexBuffer.Free();
-			m_LineVertexBuffer.Free();
+			for (auto& batch : m_Batches) batch.Quads.Free();
+			m_Batches.clear();
+
+			for (auto& lines : m_LineBatches) lines.Free();
+			m_LineBatches.clear();
 
 			for (auto& texture : Textures) texture.Destroy();
 		}
+
+	private:
+		void AllocateBatch()
+		{
+			auto& batch = m_Batches.emplace_back();
+			batch.Quads.Allocate(MaxQuadCount);
+			batch.Quads.SetName(std::format("QuadBuffer[{}]", m_Batches.size() - 1));
+		}
+
+		void AllocateLineBatch()
+		{
+			auto& lines = m_LineBatches.emplace_back();
+			lines.Allocate(MaxLineVertexCount);
+
+			lines.SetName(std::format("LineVertexBuffer[{}]", m_LineBatches.size() - 1));
+		}
+
+		// Returns the next quad record, moving on to the next batch when the current one is full
+		QuadInstance& NextQuad()
+		{
+			if (m_Batches[m_BatchIndex].Quads.Counter == MaxQuadCount)
+				if (++m_BatchIndex == m_Batches.size()) AllocateBatch();
+
+			auto& quads = m_Batches[m_BatchIndex].Quads;
+			return quads[quads.Counter++];
+		}
+
+		// Quad covering the rectangle (center, size) of the local space of transform, which maps to clip space.
+		// RenderData only uses orthographic projections so the transform is affine and w stays 1
+		QuadInstance& PushQuad(const glm::mat4& transform, glm::vec2 center, glm::vec2 size, uint32_t texID, const glm::vec4& color, uint8_t flags)
+		{
+			auto& quad = NextQuad();
+			quad.Center = glm::vec2(transform[3]) + glm::vec2(transform[0]) * center.x + glm::vec2(transform[1]) * center.y;
+			quad.AxisX = glm::vec2(transform[0]) * size.x;
+			quad.AxisY = glm::vec2(transform[1]) * size.y;
+			quad.SetColor(color);
+			quad.TextureID = (uint16_t)texID;
+			quad.Flags = flags;
+			return quad;
+		}
+
+		glm::vec2 ToClip(const glm::vec3& position) const
+		{
+			return glm::vec2(ViewProjection[3]) + glm::vec2(ViewProjection[0]) * position.x + glm::vec2(ViewProjection[1]) * position.y + glm::vec2(ViewProjection[2]) * position.z;
+		}
+
+		FrameRingBuffer<LineVertex>& ReserveLines(uint32_t vertexCount)
+		{
+			if (m_LineBatches[m_LineBatchIndex].Counter + vertexCount <= MaxLineVertexCount)
+				return m_LineBatches[m_LineBatchIndex];
+
+			if (++m_LineBatchIndex == m_LineBatches.size()) AllocateLineBatch();
+			return m_LineBatches[m_LineBatchIndex];
+		}
 	};
 }
\ No newline at end of file
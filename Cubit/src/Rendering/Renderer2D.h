@@ -6,6 +6,7 @@
 #include <wc/vk/Descriptors.h>
 
 #include "BloomEffect.h"
+#include "GPUTimer.h"
 
 #include "RenderData.h"
 #include <imgui/imgui_impl_vulkan.h>
@@ -31,10 +32,14 @@ namespace wc
 		// Rendering
 		Framebuffer m_Framebuffer;
 		Shader m_Shader;
-		DescriptorSet m_DescriptorSet;
+		std::vector<DescriptorSet> m_DescriptorSets[FRAME_OVERLAP]; // One per RenderData quad batch
+		uint32_t m_TextureDescriptorCount = 0;
 
 		Shader m_LineShader;
-		DescriptorSet m_LineDescriptorSet;
+		std::vector<DescriptorSet> m_LineDescriptorSets[FRAME_OVERLAP]; // One per RenderData line batch
+
+		Shader m_TileShader;
+		DescriptorSet m_TileDescriptorSet;
 
 		VkDescriptorSet m_ImageID = VK_NULL_HANDLE;
 		OrthographicCamera* camera = nullptr;
@@ -61,7 +66,10 @@ namespace wc
 		Semaphore m_RtoPPSemaphore[FRAME_OVERLAP]; // Semaphore for synchronizing between main rendering and post processing
 
 		CommandBuffer m_Cmd[FRAME_OVERLAP];
+		CommandBuffer m_BackgroundCmd[FRAME_OVERLAP];
 		CommandBuffer m_ComputeCmd[FRAME_OVERLAP];
+
+		GPUTimer m_GPUTimer;
 	public:
 		Semaphore RenderSemaphore[FRAME_OVERLAP]; // Semaphore for signaling the end of the frame rendering
 		uint32_t BackgroundTexture = 0;
@@ -81,9 +89,27 @@ namespace wc
 		auto GetRenderSize() const { return m_RenderSize; }
 		auto GetAspectRatio() const { return m_AspectRatio; }
 
+		const auto& GetGPUTimings() const { return m_GPUTimer.GetTimings(); }
+		const auto& GetGPUFrameTiming() const { return m_GPUTimer.GetFrameTiming(); }
+
 		auto GetHalfSize() const { return m_RenderSize / (2.f * 64.f) * camera->Zoom; }
 		auto GetHalfSize(glm::vec2 size) const { return size / (2.f * 64.f) * camera->Zoom; }
 
+		// Bounds of the camera view in world space, grown to contain the rotated view
+		CullRect GetViewRect() const
+		{
+			glm::vec2 halfSize = GetHalfSize();
+			float angle = glm::radians(camera->Rotation);
+			float c = glm::abs(glm::cos(angle));
+			float s = glm::abs(glm::sin(angle));
+			glm::vec2 extent = { c * halfSize.x + s * halfSize.y, s * halfSize.x + c * halfSize.y };
+
+			CullRect rect;
+			rect.Min = glm::vec2(camera->Position) - extent;
+			rect.Max = glm::vec2(camera->Position) + extent;
+			return rect;
+		}
+
 		auto ScreenToWorld(glm::vec2 coords) const
 		{
 			float camX = ((2.f * coords.x / m_RenderSize.x) - 1.f);
@@ -118,6 +144,8 @@ namespace wc
 			m_CRTShader.Create("assets/shaders/crt.comp");
 			descriptorAllocator.allocate(m_CRTSet, m_CRTShader.GetDescriptorLayout());
 
+			m_GPUTimer.Create();
+
 			for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
 			{
 				m_BackgroundSemaphore[i].Create();
@@ -125,6 +153,7 @@ namespace wc
 				RenderSemaphore[i].Create();
 
 				SyncContext::CommandPool.Allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_Cmd[i]);
+				SyncContext::ComputeCommandPool.Allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_BackgroundCmd[i]);
 				SyncContext::ComputeCommandPool.Allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_ComputeCmd[i]);
 
 				m_RtoPPSemaphore[i].SetName(std::format("Renderer2D::m_RtoPPSemaphore[{}]", i));
@@ -226,8 +255,16 @@ namespace wc
 				createInfo.dynamicDescriptorCount = count;
 
 				m_Shader.Create(createInfo);
+				m_TextureDescriptorCount = count;
 
-				descriptorAllocator.allocate(m_DescriptorSet, m_Shader.GetDescriptorLayout(), &set_counts, set_counts.descriptorSetCount);
+				// Same fragment stage, the vertices come from the tile mesh buffers through a device address
+				createInfo.vertexShader = "assets/shaders/Tiles.vert";
+				createInfo.bindingFlags = &flags[1];
+				createInfo.bindingFlagCount = 1;
+
+				m_TileShader.Create(createInfo);
+
+				descriptorAllocator.allocate(m_TileDescriptorSet, m_TileShader.GetDescriptorLayout(), &set_counts, set_counts.descriptorSetCount);
 			}	
 			CreateBloom(m_Framebuffer.attachments[0].view);
 			{
@@ -270,37 +307,83 @@ namespace wc
 				createInfo.depthTest = false;
 
 				m_LineShader.Create(createInfo);
+			}
+
+			m_ImageID = MakeImGuiDescriptor(m_ImageID, { m_ScreenSampler, m_FinalImageView[2], VK_IMAGE_LAYOUT_GENERAL });
+			{
+				DescriptorWriter tileWriter;
+				tileWriter.dstSet = m_TileDescriptorSet;
+				tileWriter.write_images(1, GetTextureInfos(renderData), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+				tileWriter.Update();
+			}
 
-				descriptorAllocator.allocate(m_LineDescriptorSet, m_LineShader.GetDescriptorLayout());
+			for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
+			{
+				m_DescriptorSets[i].clear();
+				m_LineDescriptorSets[i].clear();
+			}
+			UpdateBatchDescriptors(renderData);
+		}
 
+		std::vector<VkDescriptorImageInfo> GetTextureInfos(const RenderData& renderData) const
+		{
+			std::vector<VkDescriptorImageInfo> infos;
+			for (auto& image : renderData.Textures)
+			{
+				if (infos.size() == m_TextureDescriptorCount) break;
 
-				DescriptorWriter writer;
-				writer.dstSet = m_LineDescriptorSet;
-				writer.write_buffer(0, renderData.GetLineVertexBuffer().GetDescriptorInfo(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+				VkDescriptorImageInfo imageInfo;
+				imageInfo.sampler = image.GetSampler();
+				imageInfo.imageView = image.GetView();
+				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-				writer.Update();
+				infos.push_back(imageInfo);
 			}
+			return infos;
+		}
 
-			m_ImageID = MakeImGuiDescriptor(m_ImageID, { m_ScreenSampler, m_FinalImageView[2], VK_IMAGE_LAYOUT_GENERAL });
+		// Allocates descriptor sets for batches RenderData opened since the last call, every frame
+		// in flight reads its own copy of a batch
+		void UpdateBatchDescriptors(const RenderData& renderData)
+		{
+			for (uint32_t frame = 0; frame < FRAME_OVERLAP; frame++)
 			{
-				DescriptorWriter writer;
-				writer.dstSet = m_DescriptorSet;
-				writer.write_buffer(0, renderData.GetVertexBuffer().GetDescriptorInfo(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-
-				std::vector<VkDescriptorImageInfo> infos;
-				for (auto& image : renderData.Textures)
+				auto& sets = m_DescriptorSets[frame];
+				if (sets.size() < renderData.GetBatchCount())
 				{
-					VkDescriptorImageInfo imageInfo;
-					imageInfo.sampler = image.GetSampler();
-					imageInfo.imageView = image.GetView();
-					imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					auto infos = GetTextureInfos(renderData);
 
-					infos.push_back(imageInfo);
-				}
+					VkDescriptorSetVariableDescriptorCountAllocateInfo set_counts = {};
+					set_counts.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+					set_counts.descriptorSetCount = 1;
+					set_counts.pDescriptorCounts = &m_TextureDescriptorCount;
 
-				writer.write_images(1, infos, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+					while (sets.size() < renderData.GetBatchCount())
+					{
+						const auto& quadBuffer = renderData.GetBatch((uint32_t)sets.size()).Quads.GetBuffer(frame);
+						auto& set = sets.emplace_back();
+						descriptorAllocator.allocate(set, m_Shader.GetDescriptorLayout(), &set_counts, set_counts.descriptorSetCount);
+
+						DescriptorWriter writer;
+						writer.dstSet = set;
+						writer.write_buffer(0, quadBuffer.GetDescriptorInfo(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+						writer.write_images(1, infos, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+						writer.Update();
+					}
+				}
 
-				writer.Update();
+				auto& lineSets = m_LineDescriptorSets[frame];
+				while (lineSets.size() < renderData.GetLineBatchCount())
+				{
+					const auto& vertexBuffer = renderData.GetLineBatch((uint32_t)lineSets.size()).GetBuffer(frame);
+					auto& set = lineSets.emplace_back();
+					descriptorAllocator.allocate(set, m_LineShader.GetDescriptorLayout());
+
+					DescriptorWriter writer;
+					writer.dstSet = set;
+					writer.write_buffer(0, vertexBuffer.GetDescriptorInfo(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+					writer.Update();
+				}
 			}
 		}
 
@@ -312,14 +395,18 @@ namespace wc
 
 		void Flush(RenderData& renderData)
 		{
+			WC_PROFILE_SCOPE("Renderer2D::Flush");
+
 			//if (!m_IndexCount && !m_LineVertexCount) return;
 
 			time += Globals.deltaTime;
+			m_GPUTimer.BeginFrame();
 			if (Globals.settings.Background)
 			{
-				CommandBuffer& cmd = m_ComputeCmd[CURRENT_FRAME];
+				CommandBuffer& cmd = m_BackgroundCmd[CURRENT_FRAME];
 				cmd.Reset();
 				cmd.Begin();
+				m_GPUTimer.Begin(cmd, "Background");
 
 				cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_COMPUTE, 0, m_BackgroundShader.GetPipelineLayout(), m_BackgroundSet);
 				m_BackgroundShader.Bind(cmd);
@@ -334,6 +421,7 @@ namespace wc
 				m_BackgroundShader.PushConstants(cmd, sizeof(m_Data), &m_Data);
 				cmd.Dispatch(glm::ceil((glm::vec2)m_RenderSize / glm::vec2(m_ComputeWorkGroupSize)));
 
+				m_GPUTimer.End(cmd);
 				cmd.End();
 
 				VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
@@ -366,29 +454,78 @@ namespace wc
 
 				rpInfo.renderArea.extent = { (uint32_t)m_RenderSize.x, (uint32_t)m_RenderSize.y };
 
+				m_GPUTimer.Begin(cmd, "Render 2D");
 				cmd.BeginRenderPass(rpInfo);
 
-				if (renderData.GetIndexCount())
+				UpdateBatchDescriptors(renderData);
+
+				const auto& tileMeshes = renderData.GetTileMeshes();
+				uint32_t batchCount = renderData.GetUsedBatchCount();
+
+				if (batchCount) renderData.FlushVertexData();
+
+				// Tile meshes go between the quads submitted before and after them, which may be in any batch
+				uint32_t tileBatch = tileMeshes.empty() ? UINT32_MAX : glm::min(renderData.GetTileLayerBatch(), batchCount);
+				for (uint32_t i = 0; i <= batchCount; i++)
+				{
+					uint32_t quadCount = i < batchCount ? renderData.GetBatch(i).Quads.Counter : 0;
+					uint32_t splitIndex = i == tileBatch ? glm::min(renderData.GetTileLayerIndex(), quadCount) : quadCount;
+
+					// 6 vertices per quad, Renderer2D.vert expands them from the quad records
+					if (splitIndex)
+					{
+						m_Shader.Bind(cmd);
+						cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, 0, m_Shader.GetPipelineLayout(), m_DescriptorSets[CURRENT_FRAME][i]);
+						cmd.Draw(splitIndex * 6);
+					}
+
+					if (i != tileBatch) continue;
+
+					m_TileShader.Bind(cmd);
+					cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, 0, m_TileShader.GetPipelineLayout(), m_TileDescriptorSet);
+
+					for (const auto& mesh : tileMeshes)
+					{
+						cmd.PushConstants(m_TileShader.GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4) + sizeof(VkDeviceAddress), &mesh);
+						cmd.Draw(mesh.QuadCount * 6);
+					}
+
+					if (quadCount > splitIndex)
+					{
+						m_Shader.Bind(cmd);
+						cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, 0, m_Shader.GetPipelineLayout(), m_DescriptorSets[CURRENT_FRAME][i]);
+						cmd.Draw((quadCount - splitIndex) * 6, 1, splitIndex * 6);
+					}
+				}
+
+				// Same vertex shader as the tile meshes, the quads are in world space
+				if (const auto& indirectDraws = renderData.GetIndirectDraws(); !indirectDraws.empty())
 				{
-					renderData.UploadVertexData();
-					m_Shader.Bind(cmd);
+					m_TileShader.Bind(cmd);
+					cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, 0, m_TileShader.GetPipelineLayout(), m_TileDescriptorSet);
 
-					cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, 0, m_Shader.GetPipelineLayout(), m_DescriptorSet);
-					cmd.BindIndexBuffer(renderData.GetIndexBuffer());
-					cmd.DrawIndexed(renderData.GetIndexCount());
+					for (const auto& draw : indirectDraws)
+					{
+						cmd.PushConstants(m_TileShader.GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4) + sizeof(VkDeviceAddress), &draw);
+						cmd.DrawIndirect(draw.DrawCommand);
+					}
 				}
 
-				if (renderData.GetLineVertexCount())
+				if (uint32_t lineBatchCount = renderData.GetUsedLineBatchCount())
 				{
-					renderData.UploadLineVertexData();
+					renderData.FlushLineVertexData();
 
 					m_LineShader.Bind(cmd);
-					cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, 0, m_LineShader.GetPipelineLayout(), m_LineDescriptorSet);
-					cmd.Draw(renderData.GetLineVertexCount());
+					for (uint32_t i = 0; i < lineBatchCount; i++)
+					{
+						cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, 0, m_LineShader.GetPipelineLayout(), m_LineDescriptorSets[CURRENT_FRAME][i]);
+						cmd.Draw(renderData.GetLineBatch(i).Counter);
+					}
 				}
 
 
 				cmd.EndRenderPass();
+				m_GPUTimer.End(cmd);
 				cmd.End();
 
 				VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
@@ -416,8 +553,10 @@ namespace wc
 				CommandBuffer& cmd = m_ComputeCmd[CURRENT_FRAME];
 				cmd.Reset();
 				cmd.Begin();
+				m_GPUTimer.Begin(cmd, "Post processing");
 				if (Globals.settings.Bloom)
 				{
+					m_GPUTimer.Begin(cmd, "Bloom downsample");
 					vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_BloomShader.GetPipeline());
 					uint32_t counter = 0;
 
@@ -450,7 +589,10 @@ namespace wc
 						cmd.Dispatch(dispatchSize);
 					}
 
+					m_GPUTimer.End(cmd);
+
 					// First Upsample		
+					m_GPUTimer.Begin(cmd, "Bloom upsample");
 					settings.LOD = float(m_BloomMipLevels - 2);
 					settings.Mode = (int)BloomMode::UpsampleFirst;
 					m_BloomShader.PushConstants(cmd, sizeof(settings), &settings);
@@ -471,9 +613,11 @@ namespace wc
 
 						cmd.Dispatch(glm::ceil((glm::vec2)m_BloomBuffers[2].image.GetMipSize(currentMip) / glm::vec2(m_ComputeWorkGroupSize)));
 					}
+					m_GPUTimer.End(cmd);
 				}
 
 				{
+					m_GPUTimer.Begin(cmd, "Composite");
 					cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_COMPUTE, 0, m_CompositeShader.GetPipelineLayout(), m_CompositeSet);
 					m_CompositeShader.Bind(cmd);
 					struct
@@ -483,16 +627,20 @@ namespace wc
 					m_Data.Bloom = Globals.settings.Bloom;
 					m_CompositeShader.PushConstants(cmd, sizeof(m_Data), &m_Data);
 					cmd.Dispatch(glm::ceil((glm::vec2)m_RenderSize / glm::vec2(m_ComputeWorkGroupSize)));
+					m_GPUTimer.End(cmd);
 				}
 
 				if (true)
 				{
+					m_GPUTimer.Begin(cmd, "Chromatic aberration");
 					cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_COMPUTE, 0, m_ChromaShader.GetPipelineLayout(), m_ChromaSet);
 					m_ChromaShader.Bind(cmd);
 					m_ChromaShader.PushConstants(cmd, sizeof(ChromaSettings), &ChromaSettings);
 					cmd.Dispatch(glm::ceil((glm::vec2)m_RenderSize / glm::vec2(m_ComputeWorkGroupSize)));
+					m_GPUTimer.End(cmd);
 				}
 
+				m_GPUTimer.Begin(cmd, "CRT");
 				cmd.BindDescriptorSet(VK_PIPELINE_BIND_POINT_COMPUTE, 0, m_CRTShader.GetPipelineLayout(), m_CRTSet);
 				m_CRTShader.Bind(cmd);
 				struct {
@@ -508,7 +656,9 @@ namespace wc
 
 				m_CRTShader.PushConstants(cmd, sizeof(m_Data), &m_Data);
 				cmd.Dispatch(glm::ceil((glm::vec2)m_RenderSize / glm::vec2(m_ComputeWorkGroupSize)));
+				m_GPUTimer.End(cmd);
 
+				m_GPUTimer.End(cmd);
 				cmd.End();
 
 				VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
@@ -536,6 +686,7 @@ namespace wc
 
 			m_Shader.Destroy();
 			m_LineShader.Destroy();
+			m_TileShader.Destroy();
 
 			for (int i = 0; i < ARRAYSIZE(m_FinalImage); i++)
 			{
@@ -548,6 +699,7 @@ namespace wc
 
 		void Deinit()
 		{
+			m_GPUTimer.Destroy();
 			DeinitBloom();
 			m_BackgroundShader.Destroy();
 			m_CompositeShader.Destroy();
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <wc/vk/Buffer.h>
+#include <wc/vk/SyncContext.h>
+
+#include "RenderData.h"
+
+namespace wc
+{
+	struct TileChunkMesh
+	{
+		Buffer VertexBuffer; // World space quad instances
+		VkDeviceAddress Address = 0;
+		uint32_t QuadCount = 0;
+	};
+
+	// GPU copies of the static tile geometry, one buffer per chunk. Buffers are only replaced when
+	// a chunk changes and the old ones are kept alive until no frame in flight can reference them.
+	// All chunks changed in a frame share one staging buffer and are copied with a single submit that
+	// nothing waits on, queue order puts it before the frame's draws
+	class TileMeshCache
+	{
+		std::vector<TileChunkMesh> m_Meshes;
+		uint32_t m_QuadCount = 0;
+
+		struct PendingFree
+		{
+			Buffer VertexBuffer;
+			uint64_t Frame = 0;
+		};
+		std::vector<PendingFree> m_DeletionQueue;
+		uint64_t m_Frame = 0;
+
+		// One per frame in flight, the staging buffer lives until the fence says the copies are done
+		struct Upload
+		{
+			CommandBuffer Cmd;
+			Fence Done;
+			StagingBuffer Staging;
+			bool Pending = false;
+		};
+		Upload m_Uploads[FRAME_OVERLAP];
+
+		std::vector<QuadInstance> m_Quads; // Quads of every chunk ended since the last Submit
+		std::vector<VkBufferCopy> m_Copies;
+		std::vector<VkBuffer> m_CopyTargets;
+		uint32_t m_ChunkStart = 0;
+	public:
+		void Resize(uint32_t chunkCount)
+		{
+			Clear();
+			m_Meshes.resize(chunkCount);
+		}
+
+		const TileChunkMesh& Get(uint32_t chunk) const { return m_Meshes[chunk]; }
+		uint32_t GetChunkCount() const { return (uint32_t)m_Meshes.size(); }
+		uint32_t GetQuadCount() const { return m_QuadCount; }
+
+		void BeginChunk() { m_ChunkStart = (uint32_t)m_Quads.size(); }
+
+		void AddQuad(glm::vec2 position, glm::vec2 size, uint32_t texID, const glm::vec4& color)
+		{
+			auto& quad = m_Quads.emplace_back();
+			quad.Center = position;
+			quad.AxisX = { size.x, 0.f };
+			quad.AxisY = { 0.f, size.y };
+			quad.SetColor(color);
+			quad.TextureID = (uint16_t)texID;
+			quad.Flags = 0;
+		}
+
+		// Replaces the chunk mesh with the quads added since BeginChunk, the copy is recorded by the next Submit
+		void EndChunk(uint32_t chunk)
+		{
+			auto& mesh = m_Meshes[chunk];
+			Release(mesh);
+
+			mesh.QuadCount = (uint32_t)m_Quads.size() - m_ChunkStart;
+			m_QuadCount += mesh.QuadCount;
+			if (mesh.QuadCount == 0) return;
+
+			uint32_t size = uint32_t(mesh.QuadCount * sizeof(QuadInstance));
+			mesh.VertexBuffer.Allocate(size, STORAGE_BUFFER | DEVICE_ADDRESS);
+			mesh.VertexBuffer.SetName(std::format("TileChunkMesh[{}]", chunk));
+			mesh.Address = mesh.VertexBuffer.GetDeviceAddress();
+
+			m_Copies.push_back({ m_ChunkStart * sizeof(QuadInstance), 0, size });
+			m_CopyTargets.push_back(mesh.VertexBuffer);
+		}
+
+		// Copies every chunk ended since the last Submit in one go, call after the chunks and before the frame is submitted
+		void Submit()
+		{
+			if (m_Copies.empty())
+			{
+				m_Quads.clear();
+				return;
+			}
+
+			Upload& upload = m_Uploads[m_Frame % FRAME_OVERLAP];
+			Retire(upload);
+			if (!upload.Cmd)
+			{
+				SyncContext::CommandPool.Allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY, upload.Cmd);
+				upload.Cmd.SetName("TileMeshCache::Upload");
+				upload.Done.Create();
+			}
+
+			VkDeviceSize size = m_Quads.size() * sizeof(QuadInstance);
+			upload.Staging.Allocate(size);
+			upload.Staging.SetData(m_Quads.data(), size);
+
+			upload.Cmd.Begin();
+			for (uint32_t i = 0; i < m_Copies.size(); i++)
+				vkCmdCopyBuffer(upload.Cmd, upload.Staging, m_CopyTargets[i], 1, &m_Copies[i]);
+
+			// Later submits on the graphics queue are in the barrier's second scope, so the draws see the quads
+			VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(upload.Cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			upload.Cmd.End();
+
+			VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submit.commandBufferCount = 1;
+			submit.pCommandBuffers = upload.Cmd.GetPointer();
+			SyncContext::GetGraphicsQueue().Submit(submit, upload.Done);
+			upload.Pending = true;
+
+			m_Quads.clear();
+			m_Copies.clear();
+			m_CopyTargets.clear();
+		}
+
+		// Frees buffers that are no longer referenced by any frame, call once per frame
+		void Update()
+		{
+			m_Frame++;
+			Retire(m_Uploads[m_Frame % FRAME_OVERLAP]);
+			for (uint32_t i = 0; i < m_DeletionQueue.size();)
+			{
+				if (m_Frame - m_DeletionQueue[i].Frame > FRAME_OVERLAP)
+				{
+					m_DeletionQueue[i].VertexBuffer.Free();
+					m_DeletionQueue[i] = m_DeletionQueue.back();
+					m_DeletionQueue.pop_back();
+				}
+				else i++;
+			}
+		}
+
+		void Clear()
+		{
+			for (auto& mesh : m_Meshes) Release(mesh);
+			m_Meshes.clear();
+
+			// Copies that were never submitted would write into released buffers
+			m_Quads.clear();
+			m_Copies.clear();
+			m_CopyTargets.clear();
+		}
+
+		// Only safe once the device is idle
+		void Destroy()
+		{
+			for (auto& mesh : m_Meshes)
+				if (mesh.QuadCount) mesh.VertexBuffer.Free();
+			m_Meshes.clear();
+			m_QuadCount = 0;
+
+			for (auto& pending : m_DeletionQueue) pending.VertexBuffer.Free();
+			m_DeletionQueue.clear();
+
+			for (auto& upload : m_Uploads)
+			{
+				Retire(upload);
+				if (upload.Cmd) SyncContext::CommandPool.Free(upload.Cmd);
+				if (upload.Done) upload.Done.Destroy();
+				upload = {};
+			}
+			m_Quads.clear();
+			m_Copies.clear();
+			m_CopyTargets.clear();
+		}
+
+	private:
+		// The upload was submitted FRAME_OVERLAP frames ago and the render fences since then cover it, so this rarely waits
+		void Retire(Upload& upload)
+		{
+			if (!upload.Pending) return;
+
+			upload.Done.Wait();
+			upload.Done.Reset();
+			upload.Cmd.Reset();
+			upload.Staging.Free();
+			upload.Pending = false;
+		}
+
+		void Release(TileChunkMesh& mesh)
+		{
+			if (mesh.QuadCount) m_DeletionQueue.push_back({ mesh.VertexBuffer, m_Frame });
+			m_QuadCount -= mesh.QuadCount;
+			mesh.VertexBuffer = Buffer();
+			mesh.Address = 0;
+			mesh.QuadCount = 0;
+		}
+	};
+}
@@ -2,7 +2,7 @@
 
 #include <imgui/imgui.h>
 #include "../game/Entities.h"
-#include "../game/Map.h"
+#include "../game/MapView.h"
 
 namespace wc
 {
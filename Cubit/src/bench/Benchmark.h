@@ -0,0 +1,154 @@
+#pragma once
+
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <wc/Utils/Log.h>
+
+namespace wc::Bench
+{
+	struct Result
+	{
+		std::string Name;
+		uint64_t Iterations = 0;
+		uint64_t ItemsPerIteration = 0;
+		double Seconds = 0.0;
+
+		double GetNsPerIteration() const { return Seconds * 1e9 / double(Iterations); }
+		double GetNsPerItem() const { return GetNsPerIteration() / double(ItemsPerIteration); }
+	};
+
+	// Every Run is kept here so WriteJson can save the whole session
+	inline std::vector<Result> Results;
+
+	// Keeps the compiler from dropping work whose result is never read: value's address escapes and memory is
+	// clobbered, so everything that went into value has to be computed and stored
+	template<typename T>
+	inline void DoNotOptimize(const T& value)
+	{
+#ifdef _MSC_VER
+		static const volatile void* volatile sink;
+		sink = &value;
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "g"(&value) : "memory");
+#endif
+	}
+
+	// Logs result and keeps it for WriteJson
+	inline Result& Record(Result result)
+	{
+		WC_CORE_INFO("{:<40} {:>10.2f} us/iter {:>8.2f} ns/item ({} iterations)", result.Name, result.GetNsPerIteration() * 1e-3, result.GetNsPerItem(), result.Iterations);
+		return Results.emplace_back(std::move(result));
+	}
+
+	// Runs func until minSeconds have passed (after one warm-up call) and logs the time per item
+	template<typename Func>
+	Result Run(const std::string& name, uint64_t itemsPerIteration, Func&& func, double minSeconds = 0.25)
+	{
+		using clock = std::chrono::steady_clock;
+		func();
+
+		Result result;
+		result.Name = name;
+		result.ItemsPerIteration = itemsPerIteration;
+
+		auto start = clock::now();
+		do
+		{
+			func();
+			result.Iterations++;
+			result.Seconds = std::chrono::duration<double>(clock::now() - start).count();
+		} while (result.Seconds < minSeconds);
+
+		return Record(result);
+	}
+
+	// Calls func exactly iterations times without a warm-up, for work that changes what it runs on (like stepping a
+	// simulation), so every machine and every run times the same calls
+	template<typename Func>
+	Result RunFixed(const std::string& name, uint64_t itemsPerIteration, uint64_t iterations, Func&& func)
+	{
+		using clock = std::chrono::steady_clock;
+
+		Result result;
+		result.Name = name;
+		result.ItemsPerIteration = itemsPerIteration;
+		result.Iterations = iterations;
+
+		auto start = clock::now();
+		for (uint64_t i = 0; i < iterations; i++) func();
+		result.Seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+		return Record(result);
+	}
+
+	// Runs func with the core logger limited to warnings, for code that logs every time it's measured
+	template<typename Func>
+	void Quiet(Func&& func)
+	{
+		auto& logger = Log::GetCoreLogger();
+		auto level = logger->level();
+		logger->set_level(spdlog::level::warn);
+		func();
+		logger->set_level(level);
+	}
+
+	// Same fields as Google Benchmark's --benchmark_format=json, so its compare.py can diff two runs
+	inline bool WriteJson(const std::string& filepath)
+	{
+		std::ofstream file(filepath);
+		if (!file.is_open())
+		{
+			WC_CORE_ERROR("Could not write benchmark results to {}", filepath);
+			return false;
+		}
+
+		auto escape = [](const std::string& string)
+			{
+				std::string escaped;
+				for (char c : string)
+				{
+					if (c == '"' || c == '\\') escaped += '\\';
+					escaped += c;
+				}
+				return escaped;
+			};
+
+		file << "{\n  \"context\": {\n";
+		file << "    \"executable\": \"Cubit\",\n";
+#ifdef NDEBUG
+		file << "    \"library_build_type\": \"release\"\n";
+#else
+		file << "    \"library_build_type\": \"debug\"\n";
+#endif
+		file << "  },\n  \"benchmarks\": [";
+		for (uint32_t i = 0; i < Results.size(); i++)
+		{
+			const Result& result = Results[i];
+			std::string name = escape(result.Name);
+			file << (i ? ",\n" : "\n");
+			file << std::format("    {{\"name\": \"{}\", \"run_name\": \"{}\", \"run_type\": \"iteration\", \"iterations\": {}, "
+				"\"real_time\": {:.3f}, \"cpu_time\": {:.3f}, \"time_unit\": \"ns\", \"items_per_second\": {:.1f}}}",
+				name, name, result.Iterations, result.GetNsPerIteration(), result.GetNsPerIteration(), 1e9 / result.GetNsPerItem());
+		}
+		file << "\n  ]\n}\n";
+
+		WC_CORE_INFO("Wrote {} benchmark results to {}", Results.size(), filepath);
+		return file.good();
+	}
+
+	// Logs how much faster each result is than the first one
+	inline void Compare(const std::vector<Result>& results)
+	{
+		for (uint32_t i = 1; i < results.size(); i++)
+			WC_CORE_INFO("{} vs {}: {:.2f}x", results[i].Name, results[0].Name, results[0].GetNsPerItem() / results[i].GetNsPerItem());
+	}
+}
\ No newline at end of file
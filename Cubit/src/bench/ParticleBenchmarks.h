@@ -0,0 +1,57 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "../game/ParticlePool.h"
+
+namespace wc::Bench
+{
+	// Fills a pool with count particles spread over a 200x200 area, lifetimes are long enough that none die while measuring
+	inline ParticlePool CreateParticlePool(uint32_t count)
+	{
+		ParticlePool pool;
+		pool.Resize(count);
+		pool.Count = count;
+
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> position(0.f, 200.f), velocity(-6.f, 6.f), unit(0.f, 1.f);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			pool.Positions[i] = { position(rng), position(rng) };
+			pool.Velocities[i] = { velocity(rng), velocity(rng) };
+			pool.Rotations[i] = unit(rng) * 6.2831853f;
+			pool.ColorsBegin[i] = { 0.99f, 0.83f, 0.48f, 1.f };
+			pool.ColorsEnd[i] = { 0.99f, 0.42f, 0.16f, 1.f };
+			pool.SizesBegin[i] = 0.5f + 0.3f * unit(rng);
+			pool.SizesEnd[i] = 0.f;
+			pool.LifeTimes[i] = 1e6f;
+			pool.LifeRemaining[i] = 1e6f * unit(rng) + 1.f;
+		}
+		return pool;
+	}
+
+	// Integration and quad generation, scalar against SIMD. The view covers about half of the particles
+	inline void RunParticleBenchmarks()
+	{
+		for (uint32_t count : { 1'000u, 10'000u, 100'000u })
+		{
+			std::string suffix = " (" + std::to_string(count) + ")";
+			ParticlePool pool = CreateParticlePool(count);
+			std::vector<QuadDesc> quads(count);
+			glm::vec2 viewMin(0.f), viewMax(200.f, 100.f);
+			float dt = 1.f / 144.f;
+
+			std::vector<Result> update;
+			update.push_back(Run("Particles: integrate scalar" + suffix, count, [&] { IntegrateParticlesScalar(pool, dt); DoNotOptimize(pool.Positions[0]); }));
+			update.push_back(Run("Particles: integrate SIMD" + suffix, count, [&] { IntegrateParticles(pool, dt); DoNotOptimize(pool.Positions[0]); }));
+			Compare(update);
+
+			std::vector<Result> render;
+			render.push_back(Run("Particles: build quads scalar" + suffix, count, [&] { DoNotOptimize(BuildParticleQuadsScalar(pool, viewMin, viewMax, quads.data())); }));
+			render.push_back(Run("Particles: build quads SIMD" + suffix, count, [&] { DoNotOptimize(BuildParticleQuads(pool, viewMin, viewMax, quads.data())); }));
+			Compare(render);
+		}
+	}
+}
\ No newline at end of file
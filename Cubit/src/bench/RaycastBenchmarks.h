@@ -0,0 +1,83 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "../game/Map.h"
+
+namespace wc::Bench
+{
+	// Map::Intersect once per ray against one Map::IntersectBatch call, then long rays with and without skipping empty
+	// blocks. Rays start anywhere on a 512x128 map with rolling terrain and scattered single tiles, entities are
+	// skipped so only the tile walk is measured
+	inline void RunRaycastBenchmarks()
+	{
+		Map map;
+		map.Size = { 512, 128, 1 };
+		map.Allocate();
+
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		for (uint32_t x = 0; x < map.Size.x; x++)
+		{
+			uint32_t height = 20 + uint32_t(10.f * glm::sin(float(x) * 0.05f));
+			for (uint32_t y = 0; y < height; y++) map.SetTile({ x, y, 0 }, 1);
+		}
+		for (uint32_t i = 0; i < 3000; i++)
+			map.SetTile({ rng() % map.Size.x, 20 + rng() % 100, 0 }, 1);
+
+		for (uint32_t count : { 16u, 256u, 4096u })
+		{
+			std::vector<Ray> rays;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				float angle = unit(rng) * 6.2831853f;
+				rays.emplace_back(glm::vec2(unit(rng) * map.Size.x, unit(rng) * map.Size.y), glm::vec2(glm::cos(angle), glm::sin(angle)));
+			}
+			std::vector<HitInfo> hits(count);
+
+			std::string suffix = " (" + std::to_string(count) + ")";
+			std::vector<Result> results;
+			results.push_back(Run("Raycast: Intersect" + suffix, count, [&]
+				{
+					for (uint32_t i = 0; i < count; i++) hits[i] = map.Intersect(rays[i], 0);
+					DoNotOptimize(hits[0]);
+				}));
+			results.push_back(Run("Raycast: IntersectBatch" + suffix, count, [&]
+				{
+					map.IntersectBatch(rays, hits, {}, 0);
+					DoNotOptimize(hits[0]);
+				}));
+			Compare(results);
+		}
+
+		// Long rays like the laser's, tile by tile against skipping empty occupancy blocks
+		{
+			const uint32_t count = 1024;
+			const float distance = 256.f;
+			std::vector<Ray> rays;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				float angle = unit(rng) * 6.2831853f;
+				rays.emplace_back(glm::vec2(unit(rng) * map.Size.x, unit(rng) * map.Size.y), glm::vec2(glm::cos(angle), glm::sin(angle)));
+			}
+			const TileOccupancy& occupancy = map.GetOccupancy();
+
+			std::vector<Result> results;
+			results.push_back(Run("Raycast: long rays tile by tile", count, [&]
+				{
+					glm::vec2 normal;
+					for (const Ray& ray : rays) DoNotOptimize(IntersectTilesScalar(occupancy, ray.Origin, ray.Direction, distance, normal));
+				}));
+			results.push_back(Run("Raycast: long rays block skipping", count, [&]
+				{
+					glm::vec2 normal;
+					for (const Ray& ray : rays) DoNotOptimize(IntersectTiles(occupancy, ray.Origin, ray.Direction, distance, normal));
+				}));
+			Compare(results);
+		}
+
+		map.Free();
+	}
+}
\ No newline at end of file
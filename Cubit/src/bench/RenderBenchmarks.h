@@ -0,0 +1,92 @@
+#pragma once
+
+#include <random>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "../Rendering/Quad.h"
+
+namespace wc::Bench
+{
+	// Quad submission without the GPU buffers, everything is written into plain vectors
+	inline void RunQuadBenchmarks(uint32_t quadCount = 10'000)
+	{
+		// The vertex layout and DrawQuad(position, size, rotation) path before QuadInstance
+		struct LegacyVertex
+		{
+			glm::vec3 Position;
+			uint32_t TextureID = 0;
+			glm::vec2 TexCoords;
+			float Fade = 0.f;
+			float Thickness = 0.f;
+			glm::vec4 Color;
+		};
+
+		std::vector<LegacyVertex> legacyVertices(quadCount * 4);
+		std::vector<uint32_t> legacyIndices(quadCount * 6);
+		std::vector<QuadInstance> quads(quadCount);
+
+		glm::mat4 viewProjection = glm::ortho(-32.f, 32.f, -18.f, 18.f, -1.f, 1.f) * glm::translate(glm::mat4(1.f), { -100.f, -50.f, 0.f });
+
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> position(0.f, 200.f), size(0.1f, 2.f), angle(0.f, 6.2831853f), unit(0.f, 1.f);
+
+		std::vector<QuadDesc> axisAligned(quadCount), rotated(quadCount);
+		for (uint32_t i = 0; i < quadCount; i++)
+		{
+			auto& desc = axisAligned[i];
+			desc.Position = { position(rng), position(rng), 0.f };
+			desc.Size = { size(rng), size(rng) };
+			desc.Color = { unit(rng), unit(rng), unit(rng), 1.f };
+
+			rotated[i] = desc;
+			rotated[i].Rotation = angle(rng);
+		}
+
+		auto legacy = [&](const std::vector<QuadDesc>& descs)
+			{
+				for (uint32_t i = 0; i < quadCount; i++)
+				{
+					const auto& desc = descs[i];
+					glm::mat4 transform = glm::translate(glm::mat4(1.f), desc.Position) * glm::rotate(glm::mat4(1.f), desc.Rotation, { 0.f, 0.f, 1.f }) * glm::scale(glm::mat4(1.f), { desc.Size.x, desc.Size.y, 1.f });
+					transform = viewProjection * transform;
+
+					LegacyVertex* vertices = &legacyVertices[i * 4];
+					vertices[0] = { transform * glm::vec4(0.5f, 0.5f, 0.f, 1.f), desc.TextureID, { 1.f, 0.f }, 0.f, 0.f, desc.Color };
+					vertices[1] = { transform * glm::vec4(-0.5f, 0.5f, 0.f, 1.f), desc.TextureID, { 0.f, 0.f }, 0.f, 0.f, desc.Color };
+					vertices[2] = { transform * glm::vec4(-0.5f, -0.5f, 0.f, 1.f), desc.TextureID, { 0.f, 1.f }, 0.f, 0.f, desc.Color };
+					vertices[3] = { transform * glm::vec4(0.5f, -0.5f, 0.f, 1.f), desc.TextureID, { 1.f, 1.f }, 0.f, 0.f, desc.Color };
+
+					uint32_t* indices = &legacyIndices[i * 6];
+					uint32_t vertex = i * 4;
+					indices[0] = vertex;
+					indices[1] = vertex + 1;
+					indices[2] = vertex + 2;
+					indices[3] = vertex + 2;
+					indices[4] = vertex + 3;
+					indices[5] = vertex;
+				}
+				DoNotOptimize(legacyVertices.back());
+			};
+
+		for (const auto* descs : { &axisAligned, &rotated })
+		{
+			std::string suffix = descs == &axisAligned ? " (axis aligned)" : " (rotated)";
+
+			std::vector<Result> results;
+			results.push_back(Run("Quads: legacy mat4 path" + suffix, quadCount, [&] { legacy(*descs); }));
+			results.push_back(Run("Quads: WriteQuad scalar" + suffix, quadCount, [&]
+				{
+					WriteQuadsScalar(descs->data(), quadCount, viewProjection, quads.data());
+					DoNotOptimize(quads.back());
+				}));
+			results.push_back(Run("Quads: WriteQuads SIMD" + suffix, quadCount, [&]
+				{
+					WriteQuads(descs->data(), quadCount, viewProjection, quads.data());
+					DoNotOptimize(quads.back());
+				}));
+			Compare(results);
+		}
+	}
+}
\ No newline at end of file
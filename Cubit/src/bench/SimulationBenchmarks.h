@@ -0,0 +1,356 @@
+#pragma once
+
+#include <filesystem>
+#include <format>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "../game/HeadlessSimulation.h"
+#include "../game/MapDrawList.h"
+#include "../Rendering/Culling.h"
+
+namespace wc::Bench
+{
+	// Writes a size x size level: rolling ground over the bottom eighth, floating platforms above it and enemies
+	// (every fourth one a fly) spread over the open air, the player stands in the middle of the map.
+	// The .cblv goes to the temp directory, generation is seeded so every run measures the same level
+	inline std::string WriteStressLevel(uint32_t size, uint32_t enemyCount)
+	{
+		std::filesystem::path path = std::filesystem::temp_directory_path() / std::format("cubit_stress_{}_{}{}", size, enemyCount, LevelExtension);
+
+		std::mt19937 rng(size * 31 + enemyCount);
+		std::vector<TileID> tiles(size_t(size) * size, 0);
+		std::vector<uint32_t> ground(size);
+		for (uint32_t x = 0; x < size; x++)
+		{
+			ground[x] = size / 8 + uint32_t(6.f + 5.f * glm::sin(float(x) * 0.05f) + 3.f * glm::sin(float(x) * 0.011f));
+			for (uint32_t y = 0; y < ground[x]; y++) tiles[size_t(y) * size + x] = 1;
+		}
+
+		for (uint32_t i = 0; i < size * size / 2048; i++)
+		{
+			uint32_t length = 4 + rng() % 9;
+			uint32_t x = rng() % (size - length);
+			uint32_t y = ground[x] + 4 + rng() % (size - ground[x] - 8);
+			for (uint32_t j = 0; j < length; j++) tiles[size_t(y) * size + x + j] = 1;
+		}
+
+		auto findAir = [&](uint32_t x)
+			{
+				for (uint32_t y = ground[x] + 1 + rng() % (size / 2); y < size - 1; y++)
+					if (tiles[size_t(y) * size + x] == 0 && tiles[size_t(y + 1) * size + x] == 0) return y;
+				return size - 1;
+			};
+
+		std::string metadata = "Entities:\n";
+		metadata += std::format("  - Position: [{}, {}]\n    Type: Player\n", size / 2, ground[size / 2] + 1);
+		for (uint32_t i = 0; i < enemyCount; i++)
+		{
+			uint32_t x = 1 + rng() % (size - 2);
+			metadata += std::format("  - Position: [{}, {}]\n    Type: {}\n", x, findAir(x), i % 4 == 3 ? "Fly" : "RedCube");
+		}
+
+		LevelFile::Write(path.string(), { size, size, 1 }, tiles.data(), metadata);
+		return path.string();
+	}
+
+	// Keeps count bullets in flight, new ones start anywhere in the air above the ground going in any direction
+	inline void FillBullets(Map& map, uint32_t count, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		while (map.Entities.Bullets.Size() < count)
+		{
+			float angle = unit(rng) * 6.2831853f;
+			glm::vec2 position(unit(rng) * map.Size.x, (0.25f + 0.75f * unit(rng)) * map.Size.y);
+			map.SpawnBullet(position, { glm::cos(angle), glm::sin(angle) }, WeaponType::Blaster, map.player.Handle);
+		}
+	}
+
+	// Long lived particles spread over an area x area square, moving slowly in every direction
+	inline void EmitStressParticles(ParticleSystem& particles, uint32_t count, float area, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		particles.Init(count, count);
+
+		ParticleProps props = {};
+		props.ColorBegin = { 0.99f, 0.83f, 0.48f, 1.f };
+		props.ColorEnd = { 0.99f, 0.42f, 0.16f, 1.f };
+		props.SizeBegin = 0.5f;
+		props.SizeVariation = 0.3f;
+		props.LifeTime = 1e6f;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			props.Position = { unit(rng) * area, unit(rng) * area };
+			props.Velocity = { unit(rng) * 12.f - 6.f, unit(rng) * 12.f - 6.f };
+			particles.Emit(props);
+		}
+	}
+
+	// Stands in for the font atlas, every glyph is one quad Advance wide
+	struct HostFont
+	{
+		float Advance = 0.5f;
+	};
+
+	// RenderData's drawing interface writing into host memory, RenderData itself needs a device. Quads are written the
+	// same way RenderData writes its mapped batches, tile meshes are kept as the chunk and its quad count like DrawTileMesh
+	struct HostDrawList
+	{
+		struct TileMeshDraw
+		{
+			uint32_t Chunk = 0;
+			uint32_t QuadCount = 0;
+		};
+
+		glm::mat4 ViewProjection = glm::mat4(1.f);
+		CullRect View;
+		CullingStats Culling;
+
+		std::vector<QuadInstance> Quads;
+		uint32_t QuadCount = 0;
+		std::vector<TileMeshDraw> TileMeshes;
+
+		void DrawTileMesh(uint32_t chunk, uint32_t quadCount) { TileMeshes.push_back({ chunk, quadCount }); }
+
+		void DrawQuad(glm::mat4 transform, uint32_t texID, const glm::vec4& color = glm::vec4(1.f))
+		{
+			transform = ViewProjection * transform;
+			auto& quad = NextQuad();
+			quad.Center = glm::vec2(transform[3]);
+			quad.AxisX = glm::vec2(transform[0]);
+			quad.AxisY = glm::vec2(transform[1]);
+			quad.SetColor(color);
+			quad.TextureID = (uint16_t)texID;
+			quad.Flags = 0;
+		}
+
+		void DrawQuad(const glm::vec3& position, glm::vec2 size, uint32_t texID = 0, const glm::vec4& color = glm::vec4(1.f))
+		{
+			WriteQuad({ .Position = position, .Size = size, .TextureID = texID, .Color = color }, ViewProjection, NextQuad());
+		}
+
+		void DrawQuads(std::span<const QuadDesc> quads)
+		{
+			Reserve((uint32_t)quads.size());
+			WriteQuads(quads.data(), (uint32_t)quads.size(), ViewProjection, Quads.data() + QuadCount);
+			QuadCount += (uint32_t)quads.size();
+		}
+
+		void DrawCircle(glm::vec3 position, float radius, float thickness = 1.f, float fade = 0.05f, const glm::vec4& color = glm::vec4(1.f))
+		{
+			auto& quad = NextQuad();
+			quad.Center = glm::vec2(ViewProjection[3]) + glm::vec2(ViewProjection[0]) * position.x + glm::vec2(ViewProjection[1]) * position.y;
+			quad.AxisX = glm::vec2(ViewProjection[0]) * (2.f * radius);
+			quad.AxisY = glm::vec2(ViewProjection[1]) * (2.f * radius);
+			quad.SetColor(color);
+			quad.TextureID = 0;
+			quad.Flags = QUAD_CIRCLE;
+			quad.Params = glm::packHalf2x16({ thickness, fade });
+		}
+
+		// One quad per character that isn't a space, RenderData looks up glyph bounds and kerning instead
+		void DrawString(const std::string& string, const HostFont& font, glm::vec2 position, const glm::vec4& color = glm::vec4(1.f))
+		{
+			for (char character : string)
+			{
+				if (character != ' ') DrawQuad(glm::vec3(position, 0.f), glm::vec2(font.Advance, 1.f), 0, color);
+				position.x += font.Advance;
+			}
+		}
+
+		void Reset()
+		{
+			QuadCount = 0;
+			TileMeshes.clear();
+			Culling = {};
+		}
+
+		QuadInstance& NextQuad()
+		{
+			Reserve(1);
+			return Quads[QuadCount++];
+		}
+
+		void Reserve(uint32_t count)
+		{
+			if (QuadCount + count > Quads.size()) Quads.resize(std::max<size_t>(QuadCount + count, Quads.size() * 2));
+		}
+	};
+
+	// Everything MapView::Render draws of the map: the same BuildMapDrawList and particle pass, with the tile meshes counted
+	// per chunk the way MapView's UpdateTileMeshes builds them. Returns the number of quads drawn
+	inline uint32_t BuildRenderList(const Map& map, ParticleSystem& particles, const std::vector<uint32_t>& chunkQuads, HostDrawList& drawList)
+	{
+		drawList.Reset();
+
+		MapDrawParams params;
+		for (uint32_t quadCount : chunkQuads) params.TileQuadCount += quadCount;
+		BuildMapDrawList(map, params, HostFont(), drawList, [&](uint32_t chunk)
+			{
+				if (chunkQuads[chunk]) drawList.DrawTileMesh(chunk, chunkQuads[chunk]);
+				return chunkQuads[chunk];
+			});
+		particles.OnRender(drawList);
+
+		return drawList.QuadCount + drawList.Culling.Tiles.Submitted;
+	}
+
+	// Quads per chunk of MapView's tile meshes, one per solid tile of the front layer
+	inline std::vector<uint32_t> CountChunkQuads(Map& map)
+	{
+		const TileStorage& tiles = map.GetTiles();
+		std::vector<uint32_t> chunkQuads(tiles.GetChunkTotal(), 0);
+		map.ForEachRenderDirtyChunk([&](uint32_t chunk)
+			{
+				if (tiles.IsChunkEmpty(chunk) || tiles.GetChunkCoords(chunk).z != 0) return;
+
+				glm::uvec2 min, max;
+				tiles.GetChunkBounds(chunk, min, max);
+				for (uint32_t x = min.x; x < max.x; x++)
+					for (uint32_t y = min.y; y < max.y; y++)
+						if (map.GetTile({ x, y, 0 }) != 0) chunkQuads[chunk]++;
+			});
+		return chunkQuads;
+	}
+
+	// Map::Update benchmarks time exactly MeasuredTicks after SettleTicks from a freshly loaded level. Enemies fall,
+	// chase the player, summon others and die over time, so running until a time limit would measure a different
+	// game state on a faster machine
+	inline constexpr uint32_t SettleTicks = 60;
+	inline constexpr uint32_t MeasuredTicks = 300;
+
+	inline void Tick(Map& map)
+	{
+		map.Update(Map::SimulationTime);
+		map.Events.Clear();
+	}
+
+	inline void StartTickBenchmark(Map& map, const std::string& path)
+	{
+		Quiet([&]
+			{
+				map.LoadFull(path);
+				SeedRandom(5);
+				for (uint32_t i = 0; i < SettleTicks; i++) Tick(map);
+			});
+	}
+
+	// Map::Load and CreatePhysicsWorld on growing synthetic levels, Map::Update per fixed tick with more and more
+	// enemies and bullets, Intersect against every entity, particle updates and render list construction.
+	// Levels are generated into the temp directory, the tileset and tuning are the same ones headless runs use
+	inline void RunSimulationBenchmarks()
+	{
+		HeadlessSimulation::Init();
+
+		std::mt19937 rng(23);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		Map map;
+
+		for (uint32_t size : { 256u, 1024u, 4096u })
+		{
+			std::string path = WriteStressLevel(size, 100);
+			std::string suffix = std::format(" ({}x{}, 100 enemies)", size, size);
+			uint64_t tileCount = uint64_t(size) * size;
+
+			Run("Simulation: Map::Load" + suffix, tileCount, [&]
+				{
+					Quiet([&]
+						{
+							map.Free();
+							map.Load(path);
+						});
+				});
+			map.CreatePhysicsWorld();
+
+			Run("Simulation: CreatePhysicsWorld" + suffix, tileCount, [&]
+				{
+					Quiet([&]
+						{
+							map.DestroyPhysicsWorld();
+							map.CreatePhysicsWorld();
+						});
+				});
+			map.Free();
+		}
+
+		for (uint32_t enemyCount : { 10u, 100u, 1'000u, 10'000u })
+		{
+			std::string path = WriteStressLevel(1024, enemyCount);
+			StartTickBenchmark(map, path);
+
+			RunFixed(std::format("Simulation: Map::Update per tick ({} enemies)", enemyCount), enemyCount, MeasuredTicks, [&]
+				{
+					Quiet([&] { Tick(map); });
+				});
+
+			// Rays start in the air around the player like the laser's and the shotgun's
+			std::vector<Ray> rays;
+			for (uint32_t i = 0; i < 1024; i++)
+			{
+				float angle = unit(rng) * 6.2831853f;
+				rays.emplace_back(map.player.Position + glm::vec2(unit(rng) - 0.5f, unit(rng) - 0.5f) * 64.f, glm::vec2(glm::cos(angle), glm::sin(angle)));
+			}
+			Run(std::format("Simulation: Intersect entities ({} enemies)", enemyCount), rays.size(), [&]
+				{
+					for (const Ray& ray : rays) DoNotOptimize(map.Intersect(ray));
+				});
+			map.Free();
+		}
+
+		// Top up after every tick, bullets that hit something are replaced right away
+		for (uint32_t bulletCount : { 1'000u, 10'000u })
+		{
+			std::string path = WriteStressLevel(1024, 100);
+			StartTickBenchmark(map, path);
+			std::mt19937 bulletRng(bulletCount);
+
+			RunFixed(std::format("Simulation: Map::Update per tick ({} bullets)", bulletCount), bulletCount, MeasuredTicks, [&]
+				{
+					FillBullets(map, bulletCount, bulletRng);
+					Quiet([&] { Tick(map); });
+				});
+			map.Free();
+		}
+
+		for (uint32_t particleCount : { 10'000u, 100'000u })
+		{
+			ParticleSystem particles;
+			EmitStressParticles(particles, particleCount, 1024.f, rng);
+
+			Run(std::format("Simulation: ParticleSystem::OnUpdate ({})", particleCount), particleCount, [&] { particles.OnUpdate(1.f / 144.f); });
+			particles.Destroy();
+		}
+
+		// The game's view around the player and the whole map, as if zoomed all the way out
+		{
+			std::string path = WriteStressLevel(1024, 10'000);
+			Quiet([&] { map.LoadFull(path); });
+			FillBullets(map, 10'000, rng);
+
+			ParticleSystem particles;
+			EmitStressParticles(particles, 100'000, 1024.f, rng);
+
+			std::vector<uint32_t> chunkQuads = CountChunkQuads(map);
+			HostDrawList drawList;
+			for (glm::vec2 halfSize : { glm::vec2(32.f, 18.f), glm::vec2(512.f) })
+			{
+				glm::vec2 center = halfSize.x < 512.f ? map.player.Position : glm::vec2(512.f);
+				drawList.View.Min = center - halfSize;
+				drawList.View.Max = center + halfSize;
+				drawList.ViewProjection = glm::ortho(drawList.View.Min.x, drawList.View.Max.x, drawList.View.Min.y, drawList.View.Max.y, -1.f, 1.f);
+
+				uint32_t drawn = BuildRenderList(map, particles, chunkQuads, drawList);
+				Run(std::format("Simulation: render list ({} quads, {} in tile meshes)", drawn, drawList.Culling.Tiles.Submitted), drawn, [&]
+					{
+						DoNotOptimize(BuildRenderList(map, particles, chunkQuads, drawList));
+					});
+			}
+			map.Free();
+			particles.Destroy();
+		}
+	}
+}
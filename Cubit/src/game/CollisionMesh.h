@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace wc
+{
+	// Tile outlines are traced on the corner lattice, vertex (i, j) sits at world (i - 0.5, j - 0.5).
+	// Every unit edge is directed so the solid tile is on its left, which puts the Box2D chain normal on the empty side
+	namespace Contour
+	{
+		// +x, +y, -x, -y
+		constexpr int DirX[4] = { 1, 0, -1, 0 };
+		constexpr int DirY[4] = { 0, 1, 0, -1 };
+
+		// Tile on the left/right of an edge relative to its start vertex
+		constexpr int LeftX[4] = { 0, -1, -1, 0 };
+		constexpr int LeftY[4] = { 0, 0, -1, -1 };
+		constexpr int RightX[4] = { 0, 0, -1, -1 };
+		constexpr int RightY[4] = { -1, 0, 0, -1 };
+
+		inline uint32_t TurnLeft(uint32_t d) { return (d + 1) & 3; }
+		inline uint32_t TurnRight(uint32_t d) { return (d + 3) & 3; }
+
+		struct Edge
+		{
+			glm::ivec2 Start;
+			uint32_t Dir = 0;
+
+			glm::ivec2 End() const { return Start + glm::ivec2(DirX[Dir], DirY[Dir]); }
+			glm::ivec2 Owner() const { return Start + glm::ivec2(LeftX[Dir], LeftY[Dir]); }
+
+			bool operator==(const Edge& other) const { return Start == other.Start && Dir == other.Dir; }
+		};
+
+		inline glm::vec2 ToWorld(const glm::ivec2& vertex) { return glm::vec2(vertex) - 0.5f; }
+	}
+
+	struct CollisionStats
+	{
+		uint32_t Faces = 0;        // Unit tile faces
+		uint32_t LegacyBodies = 0; // Straight face runs, one static body each in the old builder
+		uint32_t Segments = 0;     // Segments after merging collinear faces
+		uint32_t Chains = 0;
+		uint32_t Loops = 0;
+	};
+
+	// Traces the outlines of the solid tiles owned by [min, max) into polylines with collinear faces merged.
+	// isSolid(x, y) is queried outside the map too, edges only exist for tiles inside mapSize.
+	// Contours that stay inside the region are emitted as closed loops, the rest are cut at the region border
+	// and emitted as open chains with the neighbouring vertices as ghosts:
+	// emit(const glm::vec2* points, uint32_t count, bool loop, glm::vec2 prevGhost, glm::vec2 nextGhost)
+	template<typename SolidFunc, typename EmitFunc>
+	void TraceContours(const glm::ivec2& min, const glm::ivec2& max, const glm::ivec2& mapSize, SolidFunc&& isSolid, EmitFunc&& emit, CollisionStats& stats)
+	{
+		using namespace Contour;
+
+		glm::ivec2 regionSize = max - min;
+		if (regionSize.x <= 0 || regionSize.y <= 0) return;
+
+		auto inMap = [&](const glm::ivec2& tile) { return tile.x >= 0 && tile.y >= 0 && tile.x < mapSize.x && tile.y < mapSize.y; };
+		auto inRegion = [&](const Edge& edge)
+			{
+				glm::ivec2 owner = edge.Owner();
+				return owner.x >= min.x && owner.y >= min.y && owner.x < max.x && owner.y < max.y;
+			};
+
+		auto exists = [&](const Edge& edge)
+			{
+				glm::ivec2 owner = edge.Owner();
+				return inMap(owner) && isSolid(owner.x, owner.y) && !isSolid(edge.Start.x + RightX[edge.Dir], edge.Start.y + RightY[edge.Dir]);
+			};
+
+		// Left turns win so diagonal neighbours get separate outlines
+		auto next = [&](const Edge& edge, Edge& out)
+			{
+				glm::ivec2 end = edge.End();
+				for (uint32_t d : { TurnLeft(edge.Dir), edge.Dir, TurnRight(edge.Dir) })
+				{
+					out = { end, d };
+					if (exists(out)) return true;
+				}
+				return false;
+			};
+
+		auto prev = [&](const Edge& edge, Edge& out)
+			{
+				for (uint32_t d : { TurnRight(edge.Dir), edge.Dir, TurnLeft(edge.Dir) })
+				{
+					out = { edge.Start - glm::ivec2(DirX[d], DirY[d]), d };
+					Edge check;
+					if (exists(out) && next(out, check) && check == edge) return true;
+				}
+				return false;
+			};
+
+		std::vector<uint8_t> visited(size_t(regionSize.x) * regionSize.y, 0); // One bit per direction
+		auto visitedMask = [&](const Edge& edge) -> uint8_t&
+			{
+				glm::ivec2 local = edge.Owner() - min;
+				return visited[size_t(local.y) * regionSize.x + local.x];
+			};
+
+		std::vector<glm::vec2> points;
+
+		for (int y = min.y; y < max.y; y++)
+			for (int x = min.x; x < max.x; x++)
+				for (uint32_t d = 0; d < 4; d++)
+				{
+					Edge first = { glm::ivec2(x - LeftX[d], y - LeftY[d]), d };
+					if (!exists(first)) continue;
+
+					Edge inLine = { first.Start - glm::ivec2(DirX[d], DirY[d]), d };
+					if (!exists(inLine)) stats.LegacyBodies++;
+
+					if (visitedMask(first) & (1 << d)) continue;
+
+					// Walk back to where the contour enters the region
+					bool loop = false;
+					Edge start = first;
+					for (Edge p; prev(start, p) && inRegion(p);)
+					{
+						if (p == first)
+						{
+							loop = true;
+							break;
+						}
+						start = p;
+					}
+
+					points.clear();
+					points.emplace_back(ToWorld(start.Start));
+
+					Edge edge = start;
+					Edge n;
+					bool hasNext = false;
+					while (true)
+					{
+						visitedMask(edge) |= 1 << edge.Dir;
+						stats.Faces++;
+
+						hasNext = next(edge, n);
+						if (!hasNext || !inRegion(n) || (loop && n == start)) break;
+
+						if (n.Dir != edge.Dir) points.emplace_back(ToWorld(n.Start));
+						edge = n;
+					}
+
+					if (loop)
+					{
+						if (n.Dir == edge.Dir) points.erase(points.begin()); // The start vertex is in the middle of a straight run
+
+						stats.Segments += (uint32_t)points.size();
+						stats.Loops++;
+						emit(points.data(), (uint32_t)points.size(), true, glm::vec2(0.f), glm::vec2(0.f));
+					}
+					else
+					{
+						points.emplace_back(ToWorld(edge.End()));
+
+						Edge p;
+						glm::vec2 prevGhost = prev(start, p) ? ToWorld(p.Start) : points.front() - glm::vec2(DirX[start.Dir], DirY[start.Dir]);
+						glm::vec2 nextGhost = hasNext ? ToWorld(n.End()) : points.back() + glm::vec2(DirX[edge.Dir], DirY[edge.Dir]);
+
+						stats.Segments += (uint32_t)points.size() - 1;
+						stats.Chains++;
+						emit(points.data(), (uint32_t)points.size(), false, prevGhost, nextGhost);
+					}
+				}
+	}
+}
@@ -25,6 +25,28 @@ namespace wc
         Player,
     };	
 
+    constexpr uint32_t EntityTypeBit(EntityType type) { return 1u << uint32_t(type); }
+    constexpr uint32_t AllEntityTypes = ~0u;
+
+    // Refers to an entity in EntityRegistry. Pools move their entities around, handles stay valid until the entity
+    // is destroyed and then resolve to nullptr
+    struct EntityHandle
+    {
+        uint32_t Slot = UINT32_MAX;
+        uint32_t Generation = 0;
+
+        bool IsValid() const { return Slot != UINT32_MAX; }
+        bool operator==(const EntityHandle&) const = default;
+
+        // Fixture user data, 0 is left for fixtures without an entity like the terrain
+        uintptr_t ToUserData() const { return IsValid() ? (uintptr_t(Generation) << 32 | (uintptr_t(Slot) + 1)) : 0; }
+        static EntityHandle FromUserData(uintptr_t data)
+        {
+            if (data == 0) return {};
+            return { uint32_t(data & 0xffffffff) - 1, uint32_t(uint64_t(data) >> 32) };
+        }
+    };
+
     struct BaseEntity
     {
         EntityType Type = EntityType::UNDEFINED;
@@ -32,7 +54,7 @@ namespace wc
 
     struct DynamicEntity : public BaseEntity, public TransformComponent, public Rigidbody2DComponent
 	{
-		uint32_t ID = 0;
+		EntityHandle Handle;
 
         inline void SetPosition() { Body->SetTransform({ Position.x, Position.y }, 0.f); }
 
@@ -84,7 +106,7 @@ namespace wc
 
         bool Alive() { return Health > 0; }        
 
-        virtual void CreateBody(b2World* PhysicsWorld)
+        void CreateBody(b2World* PhysicsWorld)
         {
             b2BodyDef bodyDef;
             bodyDef.type = b2_dynamicBody;
@@ -101,7 +123,7 @@ namespace wc
             fixtureDef.density = EntityStats[(int)Type].Density;//
             fixtureDef.friction = 0.f;
 
-            fixtureDef.userData.pointer = (uintptr_t)this;
+            fixtureDef.userData.pointer = Handle.ToUserData();
 
             fixtureDef.shape = &shape;
             Body->CreateFixture(&fixtureDef);
@@ -112,6 +134,8 @@ namespace wc
 
     struct Player : public Entity
     {
+        static constexpr EntityType StaticType = EntityType::Player;
+
 		WeaponType PrimaryWeapon = WeaponType::Blaster;
 		WeaponType SecondaryWeapon = WeaponType::Revolver;
 		WeaponType MeleeWeapon = WeaponType::Sword;
@@ -173,6 +197,8 @@ namespace wc
     	
     struct RedCube : public Entity
     {
+        static constexpr EntityType StaticType = EntityType::RedCube;
+
         float AttackTimer = 2.f; 
         float ShootRange = 8.f;
         float DetectRange = 15.f;
@@ -184,6 +210,8 @@ namespace wc
 
 	struct Fly : public Entity
 	{
+		static constexpr EntityType StaticType = EntityType::Fly;
+
 		float AttackTimer = 5.f;
 		float ShootRange = 4.f;
 		float DetectRange = 10.f;
@@ -194,15 +222,18 @@ namespace wc
 
     struct Bullet : public Entity
     {
+        static constexpr EntityType StaticType = EntityType::Bullet;
+
+        glm::vec2 PreviousPosition; // Position before the last fixed step, for interpolation
         glm::vec2 Direction;
-        BulletType BulletType;
-        WeaponType WeaponType = WeaponType::Blaster;
+        wc::BulletType BulletType;
+        wc::WeaponType WeaponType = wc::WeaponType::Blaster;
 
         glm::vec4 Color;
 
         EntityType HitEntityType = EntityType::UNDEFINED;
-		Entity* HitEntity = nullptr;
-        Entity* SourceEntity = nullptr;
+        EntityHandle HitEntity;
+        EntityHandle SourceEntity;
         uint32_t Bounces = 0;
         float DistanceTraveled = 0.f;
 
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Entities.h"
+#include "Raycasting.h"
+
+namespace wc
+{
+	// Uniform grid over the entity AABBs (Position +- Size). Entities are referenced by their index in the
+	// list passed to Build, an entity is listed in every cell its box overlaps. Boxes reaching outside of the
+	// grid are also kept in a separate list that every query tests
+	class EntityGrid
+	{
+		glm::vec2 m_Min = glm::vec2(0.f);
+		float m_CellSize = 2.f;
+		float m_InvCellSize = 0.5f;
+		glm::ivec2 m_Size = glm::ivec2(0);
+
+		std::vector<uint32_t> m_CellStart; // Entries of cell i are m_Entries[m_CellStart[i], m_CellStart[i + 1])
+		std::vector<uint32_t> m_Entries;
+		std::vector<uint32_t> m_Outside;
+
+		std::vector<glm::vec2> m_BoxMin, m_BoxMax;
+		std::vector<glm::ivec4> m_CellRange; // Min and max cell of every entity, scratch for Build
+		std::vector<uint32_t> m_Cursor;      // Write position of every cell, scratch for Build
+
+		// Entities spanning several cells are reported once per query, so queries must not be nested
+		std::vector<uint32_t> m_Visited;
+		uint32_t m_Query = 0;
+	public:
+		// Covers [min, max], cellSize should be around the size of the larger entities
+		void Init(glm::vec2 min, glm::vec2 max, float cellSize = 2.f)
+		{
+			m_Min = min;
+			m_CellSize = cellSize;
+			m_InvCellSize = 1.f / cellSize;
+			m_Size = glm::max(glm::ivec2(glm::ceil((max - min) * m_InvCellSize)), glm::ivec2(1));
+			m_CellStart.assign(m_Size.x * m_Size.y + 1, 0);
+			m_Entries.clear();
+			m_Outside.clear();
+		}
+
+		bool IsInitialized() const { return !m_CellStart.empty(); }
+		glm::vec2 GetMin() const { return m_Min; }
+		glm::vec2 GetMax() const { return m_Min + glm::vec2(m_Size) * m_CellSize; }
+
+		// Counting sort of the entities into the cells, O(entities + cells)
+		void Build(const std::vector<Entity*>& entities)
+		{
+			uint32_t count = (uint32_t)entities.size();
+			m_BoxMin.resize(count);
+			m_BoxMax.resize(count);
+			m_CellRange.resize(count);
+			m_Outside.clear();
+			std::fill(m_CellStart.begin(), m_CellStart.end(), 0);
+
+			glm::vec2 gridMax = GetMax();
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const Entity& entity = *entities[i];
+				m_BoxMin[i] = entity.Position - entity.Size;
+				m_BoxMax[i] = entity.Position + entity.Size;
+
+				if (glm::any(glm::lessThan(m_BoxMin[i], m_Min)) || glm::any(glm::greaterThan(m_BoxMax[i], gridMax)))
+					m_Outside.push_back(i);
+
+				glm::ivec4 range = GetCellRange(m_BoxMin[i], m_BoxMax[i]);
+				m_CellRange[i] = range;
+				for (int y = range.y; y <= range.w; y++)
+					for (int x = range.x; x <= range.z; x++)
+						m_CellStart[y * m_Size.x + x + 1]++;
+			}
+
+			for (uint32_t i = 1; i < m_CellStart.size(); i++)
+				m_CellStart[i] += m_CellStart[i - 1];
+
+			m_Entries.resize(m_CellStart.back());
+			m_Cursor.assign(m_CellStart.begin(), m_CellStart.end() - 1);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const glm::ivec4& range = m_CellRange[i];
+				for (int y = range.y; y <= range.w; y++)
+					for (int x = range.x; x <= range.z; x++)
+						m_Entries[m_Cursor[y * m_Size.x + x]++] = i;
+			}
+
+			m_Visited.assign(count, 0);
+			m_Query = 0;
+		}
+
+		// Calls func(index) once for every entity whose box overlaps [min, max]
+		template<typename Func>
+		void QueryBox(glm::vec2 min, glm::vec2 max, Func&& func)
+		{
+			uint32_t query = BeginQuery();
+			glm::ivec4 range = GetCellRange(min, max);
+			for (int y = range.y; y <= range.w; y++)
+				for (int x = range.x; x <= range.z; x++)
+					VisitCell(y * m_Size.x + x, query, [&](uint32_t i)
+						{
+							if (Overlaps(i, min, max)) func(i);
+						});
+
+			for (uint32_t i : m_Outside)
+				if (m_Visited[i] != query && Overlaps(i, min, max))
+				{
+					m_Visited[i] = query;
+					func(i);
+				}
+		}
+
+		// Calls func(index) for every entity whose box comes closer than radius to center
+		template<typename Func>
+		void QueryRadius(glm::vec2 center, float radius, Func&& func)
+		{
+			QueryBox(center - radius, center + radius, [&](uint32_t i)
+				{
+					glm::vec2 closest = glm::clamp(center, m_BoxMin[i], m_BoxMax[i]);
+					glm::vec2 d = closest - center;
+					if (glm::dot(d, d) <= radius * radius) func(i);
+				});
+		}
+
+		// Walks the cells along the ray front to back (Amanatides and Woo) and calls func(index) for the entities
+		// in them. func may lower maxT when it finds a hit, cells starting past maxT are not visited
+		template<typename Func>
+		void QueryRay(const Ray& ray, float& maxT, Func&& func)
+		{
+			uint32_t query = BeginQuery();
+			for (uint32_t i : m_Outside)
+			{
+				m_Visited[i] = query;
+				func(i);
+			}
+
+			// Clip the ray against the grid bounds
+			glm::vec2 gridMax = GetMax();
+			float tEnter = 0.f;
+			float tExit = maxT;
+			for (int axis = 0; axis < 2; axis++)
+			{
+				if (ray.Direction[axis] == 0.f)
+				{
+					if (ray.Origin[axis] < m_Min[axis] || ray.Origin[axis] > gridMax[axis]) return;
+					continue;
+				}
+
+				float t0 = (m_Min[axis] - ray.Origin[axis]) * ray.InvDirection[axis];
+				float t1 = (gridMax[axis] - ray.Origin[axis]) * ray.InvDirection[axis];
+				tEnter = glm::max(tEnter, glm::min(t0, t1));
+				tExit = glm::min(tExit, glm::max(t0, t1));
+			}
+			if (tEnter > tExit) return;
+
+			glm::vec2 start = (ray.Origin + ray.Direction * tEnter - m_Min) * m_InvCellSize;
+			glm::ivec2 cell = glm::clamp(glm::ivec2(glm::floor(start)), glm::ivec2(0), m_Size - 1);
+
+			glm::ivec2 step;
+			glm::vec2 tNext, tDelta;
+			for (int axis = 0; axis < 2; axis++)
+			{
+				if (ray.Direction[axis] == 0.f)
+				{
+					step[axis] = 0;
+					tNext[axis] = FLT_MAX;
+					tDelta[axis] = FLT_MAX;
+					continue;
+				}
+
+				step[axis] = ray.Direction[axis] > 0.f ? 1 : -1;
+				float boundary = m_Min[axis] + float(cell[axis] + (step[axis] > 0 ? 1 : 0)) * m_CellSize;
+				tNext[axis] = (boundary - ray.Origin[axis]) * ray.InvDirection[axis];
+				tDelta[axis] = m_CellSize * glm::abs(ray.InvDirection[axis]);
+			}
+
+			while (true)
+			{
+				VisitCell(cell.y * m_Size.x + cell.x, query, func);
+
+				int axis = tNext.x < tNext.y ? 0 : 1;
+				if (tNext[axis] > maxT) break;
+
+				cell[axis] += step[axis];
+				if (cell[axis] < 0 || cell[axis] >= m_Size[axis]) break;
+				tNext[axis] += tDelta[axis];
+			}
+		}
+	private:
+		glm::ivec4 GetCellRange(glm::vec2 min, glm::vec2 max) const
+		{
+			glm::ivec2 cellMin = glm::clamp(glm::ivec2(glm::floor((min - m_Min) * m_InvCellSize)), glm::ivec2(0), m_Size - 1);
+			glm::ivec2 cellMax = glm::clamp(glm::ivec2(glm::floor((max - m_Min) * m_InvCellSize)), glm::ivec2(0), m_Size - 1);
+			return { cellMin, cellMax };
+		}
+
+		bool Overlaps(uint32_t i, glm::vec2 min, glm::vec2 max) const
+		{
+			return m_BoxMax[i].x >= min.x && m_BoxMin[i].x <= max.x && m_BoxMax[i].y >= min.y && m_BoxMin[i].y <= max.y;
+		}
+
+		uint32_t BeginQuery()
+		{
+			if (++m_Query == 0)
+			{
+				std::fill(m_Visited.begin(), m_Visited.end(), 0);
+				m_Query = 1;
+			}
+			return m_Query;
+		}
+
+		template<typename Func>
+		void VisitCell(uint32_t cell, uint32_t query, Func&& func)
+		{
+			for (uint32_t e = m_CellStart[cell]; e < m_CellStart[cell + 1]; e++)
+			{
+				uint32_t i = m_Entries[e];
+				if (m_Visited[i] == query) continue;
+
+				m_Visited[i] = query;
+				func(i);
+			}
+		}
+	};
+}
\ No newline at end of file
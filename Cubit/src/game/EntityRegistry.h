@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Entities.h"
+
+namespace wc
+{
+	// Dense array of one entity type. Removing swaps the last entity into the hole, so iteration always runs over
+	// contiguous memory but indices and pointers change, hold an EntityHandle to refer to an entity across frames
+	template<typename T>
+	class EntityPool
+	{
+	public:
+		uint32_t Size() const { return (uint32_t)m_Items.size(); }
+		bool Empty() const { return m_Items.empty(); }
+
+		T& operator[](uint32_t index) { return m_Items[index]; }
+		const T& operator[](uint32_t index) const { return m_Items[index]; }
+
+		auto begin() { return m_Items.begin(); }
+		auto end() { return m_Items.end(); }
+		auto begin() const { return m_Items.begin(); }
+		auto end() const { return m_Items.end(); }
+
+		void Reserve(uint32_t count)
+		{
+			m_Items.reserve(count);
+			m_Slots.reserve(count);
+		}
+	private:
+		friend class EntityRegistry;
+
+		uint32_t Add(T&& entity, uint32_t slot)
+		{
+			m_Items.push_back(std::move(entity));
+			m_Slots.push_back(slot);
+			return (uint32_t)m_Items.size() - 1;
+		}
+
+		// Returns the slot of the entity that was moved into index, UINT32_MAX if it was the last one
+		uint32_t Remove(uint32_t index)
+		{
+			uint32_t last = (uint32_t)m_Items.size() - 1;
+			uint32_t moved = UINT32_MAX;
+			if (index != last)
+			{
+				m_Items[index] = std::move(m_Items[last]);
+				m_Slots[index] = m_Slots[last];
+				moved = m_Slots[index];
+			}
+			m_Items.pop_back();
+			m_Slots.pop_back();
+			return moved;
+		}
+
+		void Clear()
+		{
+			m_Items.clear();
+			m_Slots.clear();
+		}
+
+		std::vector<T> m_Items;
+		std::vector<uint32_t> m_Slots; // Registry slot of every item, to fix up the slot of the item moved by Remove
+	};
+
+	// Owns every entity except the player, one pool per type. Handles go through a slot table that follows entities
+	// when their pool moves them, a destroyed entity's slot gets a new generation so old handles resolve to nullptr.
+	// The player lives in Map and is only registered, it has a slot but no pool
+	class EntityRegistry
+	{
+		struct Slot
+		{
+			EntityType Type = EntityType::UNDEFINED;
+			uint32_t Index = 0; // Index in the pool of Type
+			uint32_t Generation = 0;
+		};
+	public:
+		EntityPool<RedCube> RedCubes;
+		EntityPool<Fly> Flies;
+		EntityPool<Bullet> Bullets;
+
+		EntityHandle RegisterPlayer(Player& player)
+		{
+			m_Player = &player;
+			player.Handle = AllocateSlot(EntityType::Player, 0);
+			return player.Handle;
+		}
+
+		template<typename T>
+		EntityHandle Create(T entity)
+		{
+			auto& pool = GetPool<T>();
+			EntityHandle handle = AllocateSlot(entity.Type, pool.Size());
+			entity.Handle = handle;
+			pool.Add(std::move(entity), handle.Slot);
+			return handle;
+		}
+
+		void Destroy(EntityHandle handle)
+		{
+			if (!IsAlive(handle)) return;
+
+			Slot& slot = m_Slots[handle.Slot];
+			uint32_t moved = UINT32_MAX;
+			switch (slot.Type)
+			{
+			case EntityType::RedCube: moved = RedCubes.Remove(slot.Index); break;
+			case EntityType::Fly: moved = Flies.Remove(slot.Index); break;
+			case EntityType::Bullet: moved = Bullets.Remove(slot.Index); break;
+			default: break;
+			}
+			if (moved != UINT32_MAX) m_Slots[moved].Index = slot.Index;
+
+			slot.Type = EntityType::UNDEFINED;
+			slot.Generation++;
+			m_FreeSlots.push_back(handle.Slot);
+		}
+
+		bool IsAlive(EntityHandle handle) const
+		{
+			return handle.Slot < m_Slots.size() && m_Slots[handle.Slot].Generation == handle.Generation && m_Slots[handle.Slot].Type != EntityType::UNDEFINED;
+		}
+
+		// nullptr once the entity is destroyed. The pointer is only valid until the next Create or Destroy of its type
+		Entity* Get(EntityHandle handle)
+		{
+			if (!IsAlive(handle)) return nullptr;
+
+			const Slot& slot = m_Slots[handle.Slot];
+			switch (slot.Type)
+			{
+			case EntityType::RedCube: return &RedCubes[slot.Index];
+			case EntityType::Fly: return &Flies[slot.Index];
+			case EntityType::Bullet: return &Bullets[slot.Index];
+			case EntityType::Player: return m_Player;
+			default: return nullptr;
+			}
+		}
+
+		template<typename T>
+		T* Get(EntityHandle handle)
+		{
+			if (!IsAlive(handle) || m_Slots[handle.Slot].Type != T::StaticType) return nullptr;
+			if constexpr (std::is_same_v<T, Player>) return m_Player;
+			else return &GetPool<T>()[m_Slots[handle.Slot].Index];
+		}
+
+		EntityType GetType(EntityHandle handle) const { return IsAlive(handle) ? m_Slots[handle.Slot].Type : EntityType::UNDEFINED; }
+
+		// Player first, then every pool in order
+		template<typename Func>
+		void ForEach(Func&& func)
+		{
+			if (m_Player) func(static_cast<Entity&>(*m_Player));
+			for (auto& entity : RedCubes) func(static_cast<Entity&>(entity));
+			for (auto& entity : Flies) func(static_cast<Entity&>(entity));
+			for (auto& entity : Bullets) func(static_cast<Entity&>(entity));
+		}
+
+		// Only the entities with a Box2D body, bullets are simulated by Map
+		template<typename Func>
+		void ForEachCharacter(Func&& func)
+		{
+			if (m_Player) func(static_cast<Entity&>(*m_Player));
+			for (auto& entity : RedCubes) func(static_cast<Entity&>(entity));
+			for (auto& entity : Flies) func(static_cast<Entity&>(entity));
+		}
+
+		uint32_t GetCount() const { return (m_Player ? 1 : 0) + RedCubes.Size() + Flies.Size() + Bullets.Size(); }
+
+		// Handles from before stay invalid, generations are kept
+		void Clear()
+		{
+			RedCubes.Clear();
+			Flies.Clear();
+			Bullets.Clear();
+
+			if (m_Player) m_Player->Handle = EntityHandle();
+			m_Player = nullptr;
+
+			m_FreeSlots.clear();
+			for (uint32_t i = (uint32_t)m_Slots.size(); i-- > 0;)
+			{
+				if (m_Slots[i].Type != EntityType::UNDEFINED)
+				{
+					m_Slots[i].Type = EntityType::UNDEFINED;
+					m_Slots[i].Generation++;
+				}
+				m_FreeSlots.push_back(i);
+			}
+		}
+
+		template<typename T>
+		EntityPool<T>& GetPool()
+		{
+			if constexpr (std::is_same_v<T, RedCube>) return RedCubes;
+			else if constexpr (std::is_same_v<T, Fly>) return Flies;
+			else
+			{
+				static_assert(std::is_same_v<T, Bullet>, "No pool for this entity type");
+				return Bullets;
+			}
+		}
+	private:
+		EntityHandle AllocateSlot(EntityType type, uint32_t index)
+		{
+			uint32_t slot;
+			if (m_FreeSlots.size())
+			{
+				slot = m_FreeSlots.back();
+				m_FreeSlots.pop_back();
+			}
+			else
+			{
+				slot = (uint32_t)m_Slots.size();
+				m_Slots.emplace_back();
+			}
+
+			m_Slots[slot].Type = type;
+			m_Slots[slot].Index = index;
+			return { slot, m_Slots[slot].Generation };
+		}
+
+		std::vector<Slot> m_Slots;
+		std::vector<uint32_t> m_FreeSlots;
+		Player* m_Player = nullptr;
+	};
+}
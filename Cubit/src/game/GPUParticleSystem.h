@@ -0,0 +1,214 @@
+#pragma once
+
+#include <wc/Shader.h>
+
+#include "../Rendering/RenderData.h"
+#include "ParticleSystem.h"
+
+namespace wc
+{
+	// Mirrors Particle in particles.comp
+	struct GPUParticle
+	{
+		glm::vec2 Position;
+		glm::vec2 Velocity;
+		uint32_t ColorBegin[2]; // RGBA as halfs
+		uint32_t ColorEnd[2];
+		float Rotation = 0.f;
+		float SizeBegin = 0.f;
+		float SizeEnd = 0.f;
+		float LifeTime = 1.f;
+		float LifeRemaining = 0.f;
+		uint32_t _pad[3] = {};
+	};
+	static_assert(sizeof(GPUParticle) == 64, "GPUParticle has to match the std430 layout in particles.comp");
+
+	// Same interface as ParticleSystem, but the particles live in GPU memory and are simulated by particles.comp.
+	// Emitted particles are written into a per-frame upload buffer and copied into a ring of Capacity slots, like
+	// the old CPU pool the oldest particle is overwritten when the ring is full. The shader appends the visible
+	// particles as world space quads and counts them in a VkDrawIndirectCommand, Renderer2D draws them indirectly
+	class GPUParticleSystem
+	{
+	public:
+		void Init(uint32_t capacity = 262'144, uint32_t maxEmitsPerFrame = 16'384)
+		{
+			m_Capacity = capacity;
+			m_MaxEmits = glm::min(maxEmitsPerFrame, capacity);
+
+			m_Particles.Allocate(capacity * sizeof(GPUParticle), STORAGE_BUFFER | DEVICE_ADDRESS);
+			m_Particles.SetName("GPUParticleSystem::Particles");
+			m_Quads.Allocate(capacity * sizeof(QuadInstance), STORAGE_BUFFER | DEVICE_ADDRESS);
+			m_Quads.SetName("GPUParticleSystem::Quads");
+			m_DrawCommand.Allocate(sizeof(VkDrawIndirectCommand), STORAGE_BUFFER | INDIRECT_BUFFER | DEVICE_ADDRESS);
+			m_DrawCommand.SetName("GPUParticleSystem::DrawCommand");
+			m_Emits.Allocate(m_MaxEmits, TRANSFER_SRC);
+			m_Emits.SetName("GPUParticleSystem::Emits");
+
+			m_Shader.Create("assets/shaders/particles.comp");
+
+			for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
+				SyncContext::CommandPool.Allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_Cmd[i]);
+
+			m_EmitHead = 0;
+			m_Clear = true;
+		}
+
+		// The simulation runs on the GPU, this only accumulates the time step for the next OnRender
+		void OnUpdate(float deltaTime)
+		{
+			m_DeltaTime += deltaTime;
+		}
+
+		// Records and submits the emission and simulation on the graphics queue, before Renderer2D::Flush
+		// submits the frame, and queues the indirect draw of the result
+		void OnRender(RenderData& renderData)
+		{
+			CommandBuffer& cmd = m_Cmd[CURRENT_FRAME];
+			cmd.Reset();
+			cmd.Begin();
+
+			// The previous frame may still be simulating or drawing from the same buffers
+			Barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+			if (m_Clear)
+			{
+				vkCmdFillBuffer(cmd, m_Particles, 0, VK_WHOLE_SIZE, 0);
+				m_Clear = false;
+			}
+
+			if (uint32_t emitCount = m_Emits.Counter)
+			{
+				m_Emits.Flush();
+
+				// At most two copies, the second one when the emitted range wraps around the end of the ring
+				VkBufferCopy copies[2];
+				uint32_t copyCount = 0;
+				uint32_t first = glm::min(emitCount, m_Capacity - m_EmitHead);
+				copies[copyCount++] = { 0, m_EmitHead * sizeof(GPUParticle), first * sizeof(GPUParticle) };
+				if (emitCount > first)
+					copies[copyCount++] = { first * sizeof(GPUParticle), 0, (emitCount - first) * sizeof(GPUParticle) };
+
+				vkCmdCopyBuffer(cmd, m_Emits.GetBuffer(), m_Particles, copyCount, copies);
+				m_EmitHead = (m_EmitHead + emitCount) % m_Capacity;
+				m_Emits.Counter = 0;
+			}
+
+			VkDrawIndirectCommand drawCommand = { .vertexCount = 0, .instanceCount = 1, .firstVertex = 0, .firstInstance = 0 };
+			vkCmdUpdateBuffer(cmd, m_DrawCommand, 0, sizeof(drawCommand), &drawCommand);
+
+			Barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+			struct
+			{
+				VkDeviceAddress Particles;
+				VkDeviceAddress Quads;
+				VkDeviceAddress DrawCommand;
+				glm::vec2 ViewMin;
+				glm::vec2 ViewMax;
+				float DeltaTime;
+				float RotationSpeed;
+				uint32_t Capacity;
+				uint32_t _pad = 0;
+			} data;
+			data.Particles = m_Particles.GetDeviceAddress();
+			data.Quads = m_Quads.GetDeviceAddress();
+			data.DrawCommand = m_DrawCommand.GetDeviceAddress();
+			data.ViewMin = renderData.View.Min;
+			data.ViewMax = renderData.View.Max;
+			data.DeltaTime = m_DeltaTime;
+			data.RotationSpeed = ParticleRotationSpeed;
+			data.Capacity = m_Capacity;
+
+			m_Shader.Bind(cmd);
+			m_Shader.PushConstants(cmd, sizeof(data), &data);
+			cmd.Dispatch(glm::ivec3((m_Capacity + 63) / 64, 1, 1));
+
+			Barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+			cmd.End();
+
+			VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submit.commandBufferCount = 1;
+			submit.pCommandBuffers = cmd.GetPointer();
+			SyncContext::GetGraphicsQueue().Submit(submit);
+
+			m_DeltaTime = 0.f;
+			renderData.DrawQuadsIndirect(data.Quads, m_DrawCommand);
+		}
+
+		void Emit(const ParticleProps& particleProps)
+		{
+			// Everything past the upload buffer would be overwritten in the ring by this frame's own particles anyway
+			if (m_Emits.Counter == m_MaxEmits)
+				return;
+
+			GPUParticle& particle = m_Emits[m_Emits.Counter++];
+			particle.Position = particleProps.Position;
+			particle.Rotation = m_Random.NextFloat() * 2.f * glm::pi<float>();
+
+			// Velocity
+			particle.Velocity = particleProps.Velocity + particleProps.VelocityVariation * m_Random.NextFloat();
+
+			// Color
+			particle.ColorBegin[0] = glm::packHalf2x16({ particleProps.ColorBegin.r, particleProps.ColorBegin.g });
+			particle.ColorBegin[1] = glm::packHalf2x16({ particleProps.ColorBegin.b, particleProps.ColorBegin.a });
+			particle.ColorEnd[0] = glm::packHalf2x16({ particleProps.ColorEnd.r, particleProps.ColorEnd.g });
+			particle.ColorEnd[1] = glm::packHalf2x16({ particleProps.ColorEnd.b, particleProps.ColorEnd.a });
+
+			particle.LifeTime = particleProps.LifeTime;
+			particle.LifeRemaining = particleProps.LifeTime;
+			particle.SizeBegin = particleProps.SizeBegin + particleProps.SizeVariation * m_Random.NextFloat();
+			particle.SizeEnd = particleProps.SizeEnd;
+		}
+
+		void Emit(const ParticleProps& particleProps, uint32_t amount)
+		{
+			for (uint32_t i = 0; i < amount; i++) Emit(particleProps);
+		}
+
+		// The particle buffer is cleared on the GPU with the next OnRender
+		void Reset()
+		{
+			m_Emits.Counter = 0;
+			m_EmitHead = 0;
+			m_Clear = true;
+		}
+
+		uint32_t GetCapacity() const { return m_Capacity; }
+
+		void Destroy()
+		{
+			m_Shader.Destroy();
+			m_Particles.Free();
+			m_Quads.Free();
+			m_DrawCommand.Free();
+			m_Emits.Free();
+		}
+	private:
+		static void Barrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+		{
+			VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		ComputeShader m_Shader;
+		CommandBuffer m_Cmd[FRAME_OVERLAP];
+
+		Buffer m_Particles;
+		Buffer m_Quads;
+		Buffer m_DrawCommand;
+		FrameRingBuffer<GPUParticle> m_Emits; // Particles emitted this frame, copied into m_Particles at m_EmitHead
+
+		uint32_t m_Capacity = 0;
+		uint32_t m_MaxEmits = 0;
+		uint32_t m_EmitHead = 0;
+		float m_DeltaTime = 0.f;
+		bool m_Clear = false;
+		Random m_Random; // Not the gameplay stream, see ParticleSystem
+	};
+}
\ No newline at end of file
@@ -32,7 +32,10 @@
 #include "../Rendering/Renderer2D.h"
 #include "UI/Widgets.h"
 
+#include "GameplayStats.h"
+#include "InputRecording.h"
 #include "Map.h"
+#include "MapView.h"
 
 namespace wc
 {
@@ -40,145 +43,36 @@ namespace wc
 	{
 	protected:
 		Map m_Map;
+		MapView m_View;
 		uint32_t m_LevelID = 0;
 
+		PlayerInput m_Input;
+		bool m_HasInput = false; // Only sampled while the window has focus
+
+		InputRecording m_Recording;
+		bool m_IsRecording = false;
+		uint32_t m_RecordingCount = 0;
+
 	public:	
+		std::string RecordPath; // Set by --record, every level attempt is saved for replays
 
 		void Create(glm::vec2 renderSize)
 		{
 			m_RenderData.Create();
-			m_Renderer.Init(m_Map.camera);
-			m_Map.font.Load("assets/fonts/ST-SimpleSquare.ttf", m_RenderData);
+			m_Renderer.Init(m_View.Camera);
+			m_View.font.Load("assets/fonts/ST-SimpleSquare.ttf", m_RenderData);
 
 			m_Tileset.Load();
 
-			m_Map.SwordTexture = m_RenderData.LoadTexture("assets/textures/Sword.png");
+			m_View.SwordTexture = m_RenderData.LoadTexture("assets/textures/Sword.png");
 
-			{
-			//	auto& redcube = EntityStats[(int)EntityType::RedCube];
-			//	redcube.Density = 55.f;
-			}
-
-			{
-				auto& redcube = EntityStats[(int)EntityType::RedCube];
-				redcube.Density = 55.f;
-				redcube.Speed = 7.f;
-				redcube.LinearDamping = 1.8f;
-			}
-			
-			{
-				auto& fly = EntityStats[(int)EntityType::Fly];
-				fly.Density = 35.f;
-				fly.Speed = 7.f;
-				fly.LinearDamping = 1.8f;
-			}
-
-			{
-				auto& player = EntityStats[(int)EntityType::Player];
-				player.Density = 100.f;
-				player.Speed = 7.f;
-				player.LinearDamping = 1.5f;
-			}
-
-			{
-				auto& blaster = WeaponStats[(int)WeaponType::Blaster];
-				blaster.BulletType = BulletType::Blaster;
-				blaster.WeaponClass = WeaponClass::Primary;
-				blaster.CanZoom = true;
-				blaster.Damage = 30;
-				blaster.FireRate = 0.3f;
-				blaster.MaxMag = 15;
-				blaster.ReloadSpeed = 1.5f;
-				blaster.Range = 50.f;
-				blaster.BulletColor = { 0.f, 1.f, 0.f, 1.f };
-				blaster.BulletSpeed = 25.f;
-				blaster.BulletSize = { 0.25f, 0.25f };
-				blaster.Recoil = { 0.25f, -0.15f };
-				blaster.RenderOffset = { 0.25f, -0.15f };
-				blaster.RenderSize = { 1.f, 0.45f };
-				blaster.TextureID = m_RenderData.LoadTexture("assets/textures/Plasma_Rifle.png");
-			}
-
-			{
-				auto& laser = WeaponStats[(int)WeaponType::Laser];
-				laser.WeaponClass = WeaponClass::Primary;
-				laser.CanZoom = true;
-				laser.Damage = 60;
-				laser.FireRate = 1.5f;
-				laser.MaxMag = 5;
-				laser.ReloadSpeed = 2.5f;
-				laser.Range = 50.f;
-				laser.BulletSize = { 0.25f, 0.25f };
-				laser.Recoil = { 0.15f, -0.15f };
-				laser.RenderOffset = { 0.0f, -0.0f };
-				laser.RenderSize = { 1.5f, 0.45f };
-				laser.TextureID = m_RenderData.LoadTexture("assets/textures/LaserGun.png");
-			}
-
-			{
-				auto& shotgun = WeaponStats[(int)WeaponType::Shotgun];
-				shotgun.BulletType = BulletType::Shotgun;
-				shotgun.WeaponClass = WeaponClass::Secondary;
-				shotgun.Damage = 18;
-				shotgun.FireRate = 1.1f;
-				shotgun.MaxMag = 4;
-				shotgun.ReloadSpeed = 0.5f;
-				shotgun.ReloadByOne = true;
-				shotgun.Range = 5.5f;
-				shotgun.BulletColor = { 1.f, 1.f, 0.f, 1.f };
-				shotgun.BulletSpeed = 25.f;
-				shotgun.BulletSize = { 0.1f, 0.1f };
-				shotgun.Recoil = { 0.25f, -0.15f };
-				shotgun.RenderOffset = { 0.25f, -0.15f };
-				shotgun.RenderSize = { 1.f, 0.45f };
-				shotgun.TextureID = m_RenderData.LoadTexture("assets/textures/Sawed-Off.png");
-			}
-
-			{
-				auto& revolver = WeaponStats[(int)WeaponType::Revolver];
-				revolver.BulletType = BulletType::Revolver;
-				revolver.WeaponClass = WeaponClass::Secondary;
-				revolver.Damage = 25;
-				revolver.FireRate = 1.f;
-				revolver.AltFireRate = 1.5f;
-				revolver.MaxMag = 6;
-				revolver.ReloadSpeed = 0.5f;
-				revolver.ReloadByOne = true;
-				revolver.Range = 25.f;
-				revolver.RenderOffset = { 0.25f, -0.15f };
-				revolver.RenderSize = { 1.f, 0.45f };
-				revolver.IsBulletSensor = false;
-				revolver.BulletColor = { 1.f, 1.f, 0.f, 1.f };
-				revolver.BulletSpeed = 25.f;
-				revolver.BulletSize = { 0.1f, 0.1f };
-				revolver.BulletBounces = 3;
-				revolver.TextureID = m_RenderData.LoadTexture("assets/textures/Revolver.png");
-			}
-
-			{
-				auto& redBlaster = WeaponStats[(int)WeaponType::RedBlaster];
-				redBlaster.WeaponClass = WeaponClass::EnemyWeapon;
-				redBlaster.BulletType = BulletType::RedCircle;
-				redBlaster.Damage = 5;
-				redBlaster.FireRate = 0.3f;
-				redBlaster.Range = 50.f;
-				redBlaster.BulletColor = { 1.f, 0, 0, 1.f };
-				redBlaster.BulletSpeed = 0.f;
-				redBlaster.BulletSize = { 0.25f, 0.25f };
-				redBlaster.RenderOffset = { 0.25f, -0.15f };
-				redBlaster.RenderSize = { 1.f, 0.45f };
-				redBlaster.TextureID = m_RenderData.LoadTexture("assets/textures/Plasma_Rifle.png");
-			}
-
-			{
-				auto& sword = WeaponStats[(int)WeaponType::Sword];
-				sword.WeaponClass = WeaponClass::Melee;
-				sword.Damage = 50;
-				sword.FireRate = 2.5f;
-				sword.Range = 15.f;
-				sword.RenderSize = { 1.f, 0.45f };
-				sword.TextureID = m_RenderData.LoadTexture("assets/textures/Sword.png");
-			}
+			LoadGameplayStats();
+			WeaponStats[(int)WeaponType::Blaster].TextureID = m_RenderData.LoadTexture("assets/textures/Plasma_Rifle.png");
+			WeaponStats[(int)WeaponType::Laser].TextureID = m_RenderData.LoadTexture("assets/textures/LaserGun.png");
+			WeaponStats[(int)WeaponType::Shotgun].TextureID = m_RenderData.LoadTexture("assets/textures/Sawed-Off.png");
+			WeaponStats[(int)WeaponType::Revolver].TextureID = m_RenderData.LoadTexture("assets/textures/Revolver.png");
+			WeaponStats[(int)WeaponType::RedBlaster].TextureID = m_RenderData.LoadTexture("assets/textures/Plasma_Rifle.png");
+			WeaponStats[(int)WeaponType::Sword].TextureID = m_RenderData.LoadTexture("assets/textures/Sword.png");
 
 			m_Renderer.CreateScreen(renderSize, m_RenderData);
 			m_ParticleEmitter.Init();
@@ -203,13 +97,60 @@ namespace wc
 		
 		void InputGame()
 		{
-			m_Map.InputGame();
+			m_Input = m_View.GatherInput(m_Map);
+			m_HasInput = true;
 		}		
 
 		void Update()
 		{
-			m_Map.UpdateGame();
-			m_Map.RenderGame();
+			if (m_HasInput) m_Map.ApplyInput(m_Input, Globals.deltaTime);
+			m_Map.Update(Globals.deltaTime);
+			m_View.Update(m_Map, m_HasInput ? &m_Input : nullptr, Globals.deltaTime);
+
+			if (!m_Map.player.Alive()) Globals.gameState = GameState::DEATH;
+			if (m_Map.EnemyCount == 0) Globals.gameState = GameState::WIN;
+
+			if (m_IsRecording)
+			{
+				auto& frame = m_Recording.Frames.emplace_back(RecordedFrame::Create(Globals.deltaTime, m_HasInput ? &m_Input : nullptr));
+				frame.StateHash = m_Map.HashState();
+				if (Globals.gameState != GameState::PLAY) SaveRecording();
+			}
+			m_HasInput = false;
+
+			m_View.Render(m_Map);
+		}
+
+		// With a RecordPath the attempt is recorded from here, the random stream is reseeded so a replay can repeat it
+		void LoadLevel(const std::string& filepath)
+		{
+			SaveRecording();
+			m_Map.LoadFull(filepath);
+			m_View.OnLoad(m_Map);
+			if (RecordPath.empty() || !m_Map.IsLoaded()) return;
+
+			m_Recording = {};
+			m_Recording.Level = filepath;
+			m_Recording.Seed = GetRandom().NextUint64();
+			m_Recording.PrimaryWeapon = m_Map.player.PrimaryWeapon;
+			m_Recording.SecondaryWeapon = m_Map.player.SecondaryWeapon;
+			m_Recording.MeleeWeapon = m_Map.player.MeleeWeapon;
+			SeedRandom(m_Recording.Seed);
+			m_IsRecording = true;
+		}
+
+		// The first attempt goes to RecordPath, later ones get a number appended
+		void SaveRecording()
+		{
+			if (!m_IsRecording) return;
+			m_IsRecording = false;
+
+			std::filesystem::path path(RecordPath);
+			if (m_RecordingCount > 0) path.replace_filename(std::format("{}_{}{}", path.stem().string(), m_RecordingCount, path.extension().string()));
+			m_RecordingCount++;
+
+			if (m_Recording.Save(path.string()))
+				WC_CORE_INFO("Recorded {} frames of {} to {}", m_Recording.Frames.size(), m_Recording.Level, path.string());
 		}
 
 		void UI_Data()
@@ -226,6 +167,26 @@ namespace wc
 			ImGui::TextColored(color, std::format("Current Level: {}", m_LevelID).c_str());
 			ImGui::SetCursorPosX(10.f);
 			ImGui::TextColored(color, std::format("Ammo: {}/{}", m_Map.player.Weapons[(int)m_Map.player.Weapon].Magazine, m_Map.player.Weapons[(int)m_Map.player.Weapon].Ammo).c_str());
+			ImGui::SetCursorPosX(10.f);
+			const auto& culling = m_RenderData.LastCulling;
+			ImGui::TextColored(color, std::format("Drawn/Culled: tiles {}/{}, entities {}/{}, particles {}/{}, text {}/{}",
+				culling.Tiles.Submitted, culling.Tiles.Culled, culling.Entities.Submitted, culling.Entities.Culled,
+				culling.Particles.Submitted, culling.Particles.Culled, culling.Text.Submitted, culling.Text.Culled).c_str());
+
+			// Passes are nested by depth. Background runs on the compute queue next to the 2D pass, so the frame
+			// time is the span of all passes rather than the sum of the top level ones
+			const auto& gpuTimings = m_Renderer.GetGPUTimings();
+			if (!gpuTimings.empty())
+			{
+				glm::uvec2 renderSize = m_Renderer.GetRenderSize();
+				ImGui::SetCursorPosX(10.f);
+				ImGui::TextColored(color, std::format("GPU at {}x{}: {:.3f} ms", renderSize.x, renderSize.y, m_Renderer.GetGPUFrameTiming().Average).c_str());
+				for (const auto& timing : gpuTimings)
+				{
+					ImGui::SetCursorPosX(20.f + timing.Depth * 10.f);
+					ImGui::TextColored(color, std::format("{}: {:.3f} ms", timing.Name, timing.Average).c_str());
+				}
+			}
 			//ImGui::SetCursorPosX(10.f);
 			//ImGui::TextColored(color, std::format("Accumulator: {}", m_Map.player.Weapons[(int)m_Map.player.MeleeWeapon].Timer).c_str());
 			//ImGui::SetCursorPosX(10.f);
@@ -274,7 +235,7 @@ namespace wc
 			ImGui::SetCursorPos(ImVec2((ImGui::GetWindowSize().x - PlaySize.x) * 0.5f, (ImGui::GetWindowSize().y - PlaySize.y) * 0.5f));
 			if (ImGui::Button("PLAY"))
 			{
-				m_Map.LoadFull("levels/level1.malen");
+				LoadLevel("levels/level1.cblv");
 				Globals.gameState = GameState::PLAY;
 			}
 
@@ -550,7 +511,7 @@ namespace wc
 			{
 				Globals.gameState = GameState::PLAY;
 				m_Map.EnemyCount = 0;
-				m_Map.LoadFull("levels/level2.malen");
+				LoadLevel("levels/level2.cblv");
 				m_Map.player.Health = m_Map.player.StartHealth;
 				m_LevelID++;
 			}
@@ -590,9 +551,12 @@ namespace wc
 
 		void DestroyGame()
 		{
+			SaveRecording();
 			m_Renderer.Deinit();
+			m_ParticleEmitter.Destroy();
 			m_RenderData.Destroy();
 			m_Map.Free();
+			m_View.Destroy();
 		}
 	};
 }
\ No newline at end of file
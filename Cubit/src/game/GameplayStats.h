@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Entities.h"
+#include "Weapons.h"
+
+namespace wc
+{
+	// Entity and weapon tuning shared by the game and headless runs, weapon textures are loaded by GameInstance
+	inline void LoadGameplayStats()
+	{
+		{
+			auto& redcube = EntityStats[(int)EntityType::RedCube];
+			redcube.Density = 55.f;
+			redcube.Speed = 7.f;
+			redcube.LinearDamping = 1.8f;
+		}
+		
+		{
+			auto& fly = EntityStats[(int)EntityType::Fly];
+			fly.Density = 35.f;
+			fly.Speed = 7.f;
+			fly.LinearDamping = 1.8f;
+		}
+
+		{
+			auto& player = EntityStats[(int)EntityType::Player];
+			player.Density = 100.f;
+			player.Speed = 7.f;
+			player.LinearDamping = 1.5f;
+		}
+
+		{
+			auto& blaster = WeaponStats[(int)WeaponType::Blaster];
+			blaster.BulletType = BulletType::Blaster;
+			blaster.WeaponClass = WeaponClass::Primary;
+			blaster.CanZoom = true;
+			blaster.Damage = 30;
+			blaster.FireRate = 0.3f;
+			blaster.MaxMag = 15;
+			blaster.ReloadSpeed = 1.5f;
+			blaster.Range = 50.f;
+			blaster.BulletColor = { 0.f, 1.f, 0.f, 1.f };
+			blaster.BulletSpeed = 25.f;
+			blaster.BulletSize = { 0.25f, 0.25f };
+			blaster.Recoil = { 0.25f, -0.15f };
+			blaster.RenderOffset = { 0.25f, -0.15f };
+			blaster.RenderSize = { 1.f, 0.45f };
+		}
+
+		{
+			auto& laser = WeaponStats[(int)WeaponType::Laser];
+			laser.WeaponClass = WeaponClass::Primary;
+			laser.CanZoom = true;
+			laser.Damage = 60;
+			laser.FireRate = 1.5f;
+			laser.MaxMag = 5;
+			laser.ReloadSpeed = 2.5f;
+			laser.Range = 50.f;
+			laser.BulletSize = { 0.25f, 0.25f };
+			laser.Recoil = { 0.15f, -0.15f };
+			laser.RenderOffset = { 0.0f, -0.0f };
+			laser.RenderSize = { 1.5f, 0.45f };
+		}
+
+		{
+			auto& shotgun = WeaponStats[(int)WeaponType::Shotgun];
+			shotgun.BulletType = BulletType::Shotgun;
+			shotgun.WeaponClass = WeaponClass::Secondary;
+			shotgun.Damage = 18;
+			shotgun.FireRate = 1.1f;
+			shotgun.MaxMag = 4;
+			shotgun.ReloadSpeed = 0.5f;
+			shotgun.ReloadByOne = true;
+			shotgun.Range = 5.5f;
+			shotgun.BulletColor = { 1.f, 1.f, 0.f, 1.f };
+			shotgun.BulletSpeed = 25.f;
+			shotgun.BulletSize = { 0.1f, 0.1f };
+			shotgun.Recoil = { 0.25f, -0.15f };
+			shotgun.RenderOffset = { 0.25f, -0.15f };
+			shotgun.RenderSize = { 1.f, 0.45f };
+		}
+
+		{
+			auto& revolver = WeaponStats[(int)WeaponType::Revolver];
+			revolver.BulletType = BulletType::Revolver;
+			revolver.WeaponClass = WeaponClass::Secondary;
+			revolver.Damage = 25;
+			revolver.FireRate = 1.f;
+			revolver.AltFireRate = 1.5f;
+			revolver.MaxMag = 6;
+			revolver.ReloadSpeed = 0.5f;
+			revolver.ReloadByOne = true;
+			revolver.Range = 25.f;
+			revolver.RenderOffset = { 0.25f, -0.15f };
+			revolver.RenderSize = { 1.f, 0.45f };
+			revolver.IsBulletSensor = false;
+			revolver.BulletColor = { 1.f, 1.f, 0.f, 1.f };
+			revolver.BulletSpeed = 25.f;
+			revolver.BulletSize = { 0.1f, 0.1f };
+			revolver.BulletBounces = 3;
+		}
+
+		{
+			auto& redBlaster = WeaponStats[(int)WeaponType::RedBlaster];
+			redBlaster.WeaponClass = WeaponClass::EnemyWeapon;
+			redBlaster.BulletType = BulletType::RedCircle;
+			redBlaster.Damage = 5;
+			redBlaster.FireRate = 0.3f;
+			redBlaster.Range = 50.f;
+			redBlaster.BulletColor = { 1.f, 0, 0, 1.f };
+			redBlaster.BulletSpeed = 0.f;
+			redBlaster.BulletSize = { 0.25f, 0.25f };
+			redBlaster.RenderOffset = { 0.25f, -0.15f };
+			redBlaster.RenderSize = { 1.f, 0.45f };
+		}
+
+		{
+			auto& sword = WeaponStats[(int)WeaponType::Sword];
+			sword.WeaponClass = WeaponClass::Melee;
+			sword.Damage = 50;
+			sword.FireRate = 2.5f;
+			sword.Range = 15.f;
+			sword.RenderSize = { 1.f, 0.45f };
+		}
+	}
+}
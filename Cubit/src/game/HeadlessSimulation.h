@@ -0,0 +1,282 @@
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <wc/Utils/Time.h>
+
+#include "GameplayStats.h"
+#include "InputRecording.h"
+#include "Map.h"
+#include "PlayerInput.h"
+
+namespace wc
+{
+	// Scripted input for headless runs, one segment per line:
+	//   <ticks> <move> <aimX> <aimY> [jump] [dash] [fire] [alt] [melee] [reload] [switch] [primary] [secondary]
+	// The input is held for <ticks> fixed ticks, the pressed actions (jump, reload, switch, primary, secondary) only
+	// on the first of them. Lines starting with # are comments, the script starts over when it runs out
+	class InputScript
+	{
+		struct Segment
+		{
+			uint32_t Ticks = 1;
+			PlayerInput Input;
+		};
+
+		std::vector<Segment> m_Segments;
+		uint32_t m_Segment = 0;
+		uint32_t m_Tick = 0; // Within the current segment
+	public:
+		bool Parse(std::istream& stream)
+		{
+			m_Segments.clear();
+			m_Segment = 0;
+			m_Tick = 0;
+
+			std::string line;
+			for (uint32_t lineNumber = 1; std::getline(stream, line); lineNumber++)
+			{
+				std::istringstream words(line);
+				Segment segment;
+				if (line.empty() || line[0] == '#' || !(words >> segment.Ticks)) continue;
+
+				PlayerInput& input = segment.Input;
+				if (!(words >> input.MoveDir >> input.Aim.x >> input.Aim.y) || segment.Ticks == 0 || glm::length(input.Aim) == 0.f)
+				{
+					WC_CORE_ERROR("Input script line {}: expected <ticks> <move> <aimX> <aimY> [actions]", lineNumber);
+					return false;
+				}
+				input.MoveDir = glm::clamp(input.MoveDir, -1.f, 1.f);
+				input.Aim = glm::normalize(input.Aim);
+
+				std::string action;
+				while (words >> action)
+				{
+					if (action == "jump") input.Jump = true;
+					else if (action == "dash") input.Dash = true;
+					else if (action == "fire") input.Fire = true;
+					else if (action == "alt") input.AltFire = true;
+					else if (action == "melee") input.Melee = true;
+					else if (action == "reload") input.Reload = true;
+					else if (action == "switch") input.SwitchWeapon = true;
+					else if (action == "primary") input.SelectPrimary = true;
+					else if (action == "secondary") input.SelectSecondary = true;
+					else
+					{
+						WC_CORE_ERROR("Input script line {}: unknown action {}", lineNumber, action);
+						return false;
+					}
+				}
+				m_Segments.push_back(segment);
+			}
+
+			if (m_Segments.empty()) WC_CORE_ERROR("Input script has no segments");
+			return !m_Segments.empty();
+		}
+
+		bool Load(const std::string& filepath)
+		{
+			std::ifstream file(filepath);
+			if (!file.is_open())
+			{
+				WC_CORE_ERROR("Could not open input script {}", filepath);
+				return false;
+			}
+			return Parse(file);
+		}
+
+		// Runs right shooting ahead, jumps, then comes back with the secondary weapon, the sword and dashes
+		void LoadDefault()
+		{
+			std::istringstream script(
+				"120 1 1 0 fire\n"
+				"1 1 1 0 jump\n"
+				"60 1 0.7 0.7 fire\n"
+				"30 0 1 0 reload\n"
+				"1 0 1 0 switch\n"
+				"120 -1 -1 0 fire\n"
+				"1 -1 -1 0 jump\n"
+				"60 -1 -1 0.3 fire alt\n"
+				"30 -1 -1 0 melee dash\n"
+				"1 0 1 0 primary\n");
+			Parse(script);
+		}
+
+		PlayerInput Next()
+		{
+			const Segment& segment = m_Segments[m_Segment];
+			PlayerInput input = segment.Input;
+			if (m_Tick > 0)
+			{
+				input.Jump = false;
+				input.Reload = false;
+				input.SwitchWeapon = false;
+				input.SelectPrimary = false;
+				input.SelectSecondary = false;
+			}
+
+			if (++m_Tick == segment.Ticks)
+			{
+				m_Tick = 0;
+				m_Segment = (m_Segment + 1) % (uint32_t)m_Segments.size();
+			}
+			return input;
+		}
+	};
+
+	// Map without a window, Vulkan device, ImGui or audio. Every Tick is one fixed step of Map::SimulationTime,
+	// so runs are as fast as the CPU allows and independent of the frame rate
+	class HeadlessSimulation
+	{
+	public:
+		Map Level;
+
+		// Gameplay tuning and the tileset, everything a Map needs besides its level. Runs once
+		static void Init()
+		{
+			if (s_Initialized) return;
+
+			LoadGameplayStats();
+			m_Tileset.Load();
+			s_Initialized = true;
+		}
+
+		bool Load(const std::string& filepath)
+		{
+			Init();
+
+			m_Filepath = filepath;
+			Level.LoadFull(filepath);
+			return Level.IsLoaded();
+		}
+
+		// Same loadout, level and random stream as the game had when it started recording
+		bool Load(const InputRecording& recording)
+		{
+			Level.player.PrimaryWeapon = recording.PrimaryWeapon;
+			Level.player.SecondaryWeapon = recording.SecondaryWeapon;
+			Level.player.MeleeWeapon = recording.MeleeWeapon;
+			if (!Load(recording.Level)) return false;
+
+			SeedRandom(recording.Seed);
+			return true;
+		}
+
+		// Starts the level over, used when the player died or every enemy is dead
+		void Restart()
+		{
+			Level.Free();
+			Level.LoadFull(m_Filepath);
+			Restarts++;
+		}
+
+		void Tick(const PlayerInput& input) { Step(Map::SimulationTime, &input); }
+
+		// One Map::Update, input is nullptr for frames that apply none. Nothing plays the events, they are dropped
+		void Step(float deltaTime, const PlayerInput* input)
+		{
+			if (input) Level.ApplyInput(*input, deltaTime);
+			Level.Update(deltaTime);
+			Level.Events.Clear();
+			Ticks++;
+		}
+
+		bool IsLevelOver() { return !Level.player.Alive() || Level.EnemyCount == 0; }
+
+		void Free() { Level.Free(); }
+
+		uint64_t Ticks = 0;
+		uint32_t Restarts = 0;
+	private:
+		std::string m_Filepath;
+		inline static bool s_Initialized = false;
+	};
+
+	// Cubit --headless [level] [ticks] [input script], restarts the level whenever it ends
+	inline int RunHeadless(int argc, char** argv)
+	{
+		std::string level = argc > 2 ? argv[2] : "levels/level1.malen";
+		uint64_t tickCount = argc > 3 ? std::stoull(argv[3]) : 60'000;
+
+		InputScript script;
+		if (argc > 4)
+		{
+			if (!script.Load(argv[4])) return 1;
+		}
+		else script.LoadDefault();
+
+		HeadlessSimulation simulation;
+		if (!simulation.Load(level))
+		{
+			WC_CORE_ERROR("Could not load {}", level);
+			return 1;
+		}
+
+		Timer timer;
+		timer.Start();
+		for (uint64_t i = 0; i < tickCount; i++)
+		{
+			simulation.Tick(script.Next());
+			if (simulation.IsLevelOver()) simulation.Restart();
+		}
+		float seconds = timer.GetElapsedTime();
+
+		const Map& map = simulation.Level;
+		WC_CORE_INFO("Headless: {} ticks ({:.1f} s of game time) in {:.3f} s, {:.0f} ticks/s, {:.2f} us per tick",
+			simulation.Ticks, simulation.Ticks * Map::SimulationTime, seconds, simulation.Ticks / seconds, seconds * 1e6f / simulation.Ticks);
+		WC_CORE_INFO("Headless: {} restarts, {} enemies, player health {}, {} bullets alive",
+			simulation.Restarts, map.EnemyCount, map.player.Health, map.Entities.Bullets.Size());
+
+		simulation.Free();
+		return 0;
+	}
+
+	// Cubit --replay <recording>, reports the first frame whose state hash differs from the recorded one
+	inline int RunReplay(int argc, char** argv)
+	{
+		if (argc < 3)
+		{
+			WC_CORE_ERROR("Usage: Cubit --replay <recording>");
+			return 1;
+		}
+
+		InputRecording recording;
+		if (!recording.Load(argv[2])) return 1;
+
+		HeadlessSimulation simulation;
+		if (!simulation.Load(recording))
+		{
+			WC_CORE_ERROR("Could not load {}", recording.Level);
+			return 1;
+		}
+
+		float gameTime = 0.f;
+		Timer timer;
+		timer.Start();
+		for (size_t i = 0; i < recording.Frames.size(); i++)
+		{
+			const RecordedFrame& frame = recording.Frames[i];
+			PlayerInput input = frame.GetInput();
+			simulation.Step(frame.DeltaTime, frame.HasInput ? &input : nullptr);
+			gameTime += frame.DeltaTime;
+
+			uint64_t hash = simulation.Level.HashState();
+			if (hash != frame.StateHash)
+			{
+				WC_CORE_ERROR("Replay diverged at frame {} ({:.2f} s of game time): state hash {:016x}, recorded {:016x}", i, gameTime, hash, frame.StateHash);
+				simulation.Free();
+				return 1;
+			}
+		}
+		float seconds = timer.GetElapsedTime();
+
+		WC_CORE_INFO("Replay: {} frames ({:.1f} s of game time) of {} in {:.3f} s, {:.0f} frames/s, all state hashes match",
+			recording.Frames.size(), gameTime, recording.Level, seconds, recording.Frames.size() / seconds);
+
+		simulation.Free();
+		return 0;
+	}
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <wc/Utils/Log.h>
+
+#include "PlayerInput.h"
+#include "Weapons.h"
+
+namespace wc
+{
+	// Binary input recording of one level attempt. Layout:
+	// [RecordingHeader][level path: LevelPathSize chars][RecordedFrame * FrameCount]
+	// Replays are only exact with the same build, Box2D has to produce the same floats. Particles have their own
+	// random stream, so recordings replay headless with either particle system.
+	// Version 2: particles stopped drawing from the gameplay stream, version 1 recordings diverge
+	constexpr const char* RecordingExtension = ".cbrec";
+	constexpr uint32_t RecordingMagic = 'C' | ('B' << 8) | ('R' << 16) | ('C' << 24);
+	constexpr uint16_t RecordingVersion = 2;
+
+	// One Map::Update: the frame's delta time, the input applied before it and the state hash after it
+	struct RecordedFrame
+	{
+		enum Button : uint32_t
+		{
+			Jump = 1 << 0,
+			Dash = 1 << 1,
+			Fire = 1 << 2,
+			AltFire = 1 << 3,
+			Melee = 1 << 4,
+			Reload = 1 << 5,
+			SwitchWeapon = 1 << 6,
+			SelectPrimary = 1 << 7,
+			SelectSecondary = 1 << 8,
+		};
+
+		float DeltaTime = 0.f;
+		float MoveDir = 0.f;
+		glm::vec2 Aim = { 1.f, 0.f };
+		uint32_t Buttons = 0;
+		uint32_t HasInput = 0; // The game applies no input while its window is unfocused
+		uint64_t StateHash = 0; // Map::HashState after the update
+
+		static RecordedFrame Create(float deltaTime, const PlayerInput* input)
+		{
+			RecordedFrame frame;
+			frame.DeltaTime = deltaTime;
+			if (!input) return frame;
+
+			frame.HasInput = 1;
+			frame.MoveDir = input->MoveDir;
+			frame.Aim = input->Aim;
+			if (input->Jump) frame.Buttons |= Jump;
+			if (input->Dash) frame.Buttons |= Dash;
+			if (input->Fire) frame.Buttons |= Fire;
+			if (input->AltFire) frame.Buttons |= AltFire;
+			if (input->Melee) frame.Buttons |= Melee;
+			if (input->Reload) frame.Buttons |= Reload;
+			if (input->SwitchWeapon) frame.Buttons |= SwitchWeapon;
+			if (input->SelectPrimary) frame.Buttons |= SelectPrimary;
+			if (input->SelectSecondary) frame.Buttons |= SelectSecondary;
+			return frame;
+		}
+
+		PlayerInput GetInput() const
+		{
+			PlayerInput input;
+			input.MoveDir = MoveDir;
+			input.Aim = Aim;
+			input.Jump = Buttons & Jump;
+			input.Dash = Buttons & Dash;
+			input.Fire = Buttons & Fire;
+			input.AltFire = Buttons & AltFire;
+			input.Melee = Buttons & Melee;
+			input.Reload = Buttons & Reload;
+			input.SwitchWeapon = Buttons & SwitchWeapon;
+			input.SelectPrimary = Buttons & SelectPrimary;
+			input.SelectSecondary = Buttons & SelectSecondary;
+			return input;
+		}
+	};
+	static_assert(sizeof(RecordedFrame) == 32, "RecordedFrame layout is part of the file format");
+
+	struct RecordingHeader
+	{
+		uint32_t Magic = RecordingMagic;
+		uint16_t Version = RecordingVersion;
+		uint16_t FrameSize = sizeof(RecordedFrame);
+		uint64_t Seed = 0; // Passed to SeedRandom right after the level is loaded
+
+		WeaponType PrimaryWeapon = WeaponType::Blaster;
+		WeaponType SecondaryWeapon = WeaponType::Revolver;
+		WeaponType MeleeWeapon = WeaponType::Sword;
+		uint8_t Padding = 0;
+		uint32_t LevelPathSize = 0;
+
+		uint64_t FrameCount = 0;
+	};
+	static_assert(sizeof(RecordingHeader) == 32, "RecordingHeader layout is part of the file format");
+
+	struct InputRecording
+	{
+		std::string Level;
+		uint64_t Seed = 0;
+
+		// The loadout is picked in the menu, before the level is loaded
+		WeaponType PrimaryWeapon = WeaponType::Blaster;
+		WeaponType SecondaryWeapon = WeaponType::Revolver;
+		WeaponType MeleeWeapon = WeaponType::Sword;
+
+		std::vector<RecordedFrame> Frames;
+
+		bool Save(const std::string& filepath) const
+		{
+			RecordingHeader header;
+			header.Seed = Seed;
+			header.PrimaryWeapon = PrimaryWeapon;
+			header.SecondaryWeapon = SecondaryWeapon;
+			header.MeleeWeapon = MeleeWeapon;
+			header.LevelPathSize = (uint32_t)Level.size();
+			header.FrameCount = Frames.size();
+
+			std::ofstream file(filepath, std::ios::binary);
+			if (!file.is_open())
+			{
+				WC_CORE_ERROR("Could not write recording {}", filepath);
+				return false;
+			}
+
+			file.write((const char*)&header, sizeof(RecordingHeader));
+			file.write(Level.data(), Level.size());
+			file.write((const char*)Frames.data(), Frames.size() * sizeof(RecordedFrame));
+			return file.good();
+		}
+
+		bool Load(const std::string& filepath)
+		{
+			std::ifstream file(filepath, std::ios::binary);
+			if (!file.is_open())
+			{
+				WC_CORE_ERROR("Could not open recording {}", filepath);
+				return false;
+			}
+
+			RecordingHeader header;
+			if (!file.read((char*)&header, sizeof(RecordingHeader)) || header.Magic != RecordingMagic)
+			{
+				WC_CORE_ERROR("{} is not a recording", filepath);
+				return false;
+			}
+
+			if (header.Version != RecordingVersion || header.FrameSize != sizeof(RecordedFrame))
+			{
+				WC_CORE_ERROR("{} has unsupported version {} (frame size {})", filepath, header.Version, header.FrameSize);
+				return false;
+			}
+
+			if (sizeof(RecordingHeader) + header.LevelPathSize + header.FrameCount * sizeof(RecordedFrame) > std::filesystem::file_size(filepath))
+			{
+				WC_CORE_ERROR("{} is truncated or has a corrupted header", filepath);
+				return false;
+			}
+
+			Seed = header.Seed;
+			PrimaryWeapon = header.PrimaryWeapon;
+			SecondaryWeapon = header.SecondaryWeapon;
+			MeleeWeapon = header.MeleeWeapon;
+			Level.resize(header.LevelPathSize);
+			Frames.resize(header.FrameCount);
+			file.read(Level.data(), Level.size());
+			file.read((char*)Frames.data(), Frames.size() * sizeof(RecordedFrame));
+			return file.good();
+		}
+	};
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <wc/Utils/Log.h>
+#include <wc/Utils/MappedFile.h>
+
+#include "Tile.h"
+
+namespace wc
+{
+	// Binary level container. Layout:
+	// [LevelHeader][tiles: Size.x * Size.y * Size.z TileIDs, same order as to1D][metadata: YAML text]
+	// The tile payload is stored raw so a mapped file can be copied straight into the map
+	constexpr const char* LevelExtension = ".cblv";
+	constexpr uint32_t LevelMagic = 'C' | ('B' << 8) | ('L' << 16) | ('V' << 24);
+	constexpr uint16_t LevelVersion = 1;
+
+	struct LevelHeader
+	{
+		uint32_t Magic = LevelMagic;
+		uint16_t Version = LevelVersion;
+		uint16_t TileSize = sizeof(TileID);
+		uint32_t Size[3] = { 1, 1, 1 };
+		uint32_t Checksum = 0; // FNV-1a of the tile payload followed by the metadata
+
+		uint64_t PayloadOffset = 0;
+		uint64_t PayloadSize = 0;
+		uint64_t MetadataOffset = 0;
+		uint64_t MetadataSize = 0;
+	};
+	static_assert(sizeof(LevelHeader) == 56, "LevelHeader layout is part of the file format");
+
+	inline uint32_t LevelChecksum(const uint8_t* data, size_t size, uint32_t hash = 2166136261u)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// Decodes the text RLE body of a .malen file ("<tile> <count>" pairs), calling
+	// fill(offset, tile, count) for every run
+	template<typename Func>
+	inline size_t ParseMalenTiles(std::istream& stream, size_t tileCount, Func&& fill)
+	{
+		size_t counter = 0;
+		uint32_t block = 0;
+		uint32_t count = 0;
+
+		while (stream >> block >> count)
+		{
+			if (counter + count > tileCount)
+			{
+				WC_CORE_ERROR("Level data is larger than the declared size ({} tiles)", tileCount);
+				count = uint32_t(tileCount - counter);
+			}
+
+			fill(counter, (TileID)block, (size_t)count);
+			counter += count;
+		}
+
+		return counter;
+	}
+
+	struct LevelFile
+	{
+		LevelHeader Header;
+		const TileID* Tiles = nullptr; // Points into the mapped file
+		std::string_view Metadata;
+
+		glm::uvec3 GetSize() const { return { Header.Size[0], Header.Size[1], Header.Size[2] }; }
+		size_t GetTileCount() const { return size_t(Header.Size[0]) * Header.Size[1] * Header.Size[2]; }
+
+		bool Open(const std::string& filepath, bool verifyChecksum = true)
+		{
+			if (!m_File.Open(filepath))
+			{
+				WC_CORE_ERROR("Could not open level file {}", filepath);
+				return false;
+			}
+
+			const uint8_t* data = m_File.GetData();
+			size_t fileSize = m_File.GetSize();
+
+			if (fileSize < sizeof(LevelHeader))
+			{
+				WC_CORE_ERROR("{} is too small to be a level file", filepath);
+				return Fail();
+			}
+
+			memcpy(&Header, data, sizeof(LevelHeader));
+
+			if (Header.Magic != LevelMagic)
+			{
+				WC_CORE_ERROR("{} is not a level file", filepath);
+				return Fail();
+			}
+
+			if (Header.Version != LevelVersion || Header.TileSize != sizeof(TileID))
+			{
+				WC_CORE_ERROR("{} has unsupported version {} (tile size {})", filepath, Header.Version, Header.TileSize);
+				return Fail();
+			}
+
+			if (Header.PayloadSize != GetTileCount() * sizeof(TileID) ||
+				Header.PayloadOffset + Header.PayloadSize > fileSize ||
+				Header.MetadataOffset + Header.MetadataSize > fileSize)
+			{
+				WC_CORE_ERROR("{} is truncated or has a corrupted header", filepath);
+				return Fail();
+			}
+
+			Tiles = (const TileID*)(data + Header.PayloadOffset);
+			Metadata = std::string_view((const char*)data + Header.MetadataOffset, Header.MetadataSize);
+
+			if (verifyChecksum)
+			{
+				uint32_t checksum = LevelChecksum((const uint8_t*)Tiles, Header.PayloadSize);
+				checksum = LevelChecksum((const uint8_t*)Metadata.data(), Metadata.size(), checksum);
+				if (checksum != Header.Checksum)
+				{
+					WC_CORE_ERROR("{} failed the checksum test", filepath);
+					return Fail();
+				}
+			}
+
+			return true;
+		}
+
+		void Close()
+		{
+			m_File.Close();
+			Tiles = nullptr;
+			Metadata = {};
+		}
+
+		static bool Write(const std::string& filepath, glm::uvec3 size, const TileID* tiles, std::string_view metadata)
+		{
+			LevelHeader header;
+			header.Size[0] = size.x;
+			header.Size[1] = size.y;
+			header.Size[2] = size.z;
+			header.PayloadOffset = sizeof(LevelHeader);
+			header.PayloadSize = uint64_t(size.x) * size.y * size.z * sizeof(TileID);
+			header.MetadataOffset = header.PayloadOffset + header.PayloadSize;
+			header.MetadataSize = metadata.size();
+			header.Checksum = LevelChecksum((const uint8_t*)tiles, header.PayloadSize);
+			header.Checksum = LevelChecksum((const uint8_t*)metadata.data(), metadata.size(), header.Checksum);
+
+			std::ofstream file(filepath, std::ios::binary);
+			if (!file.is_open())
+			{
+				WC_CORE_ERROR("Could not write level file {}", filepath);
+				return false;
+			}
+
+			file.write((const char*)&header, sizeof(LevelHeader));
+			file.write((const char*)tiles, header.PayloadSize);
+			file.write(metadata.data(), metadata.size());
+			return file.good();
+		}
+
+		// Converts a .malen + .metadata pair into a binary level. If outPath is empty the
+		// result is written next to the source with the binary extension
+		static bool Convert(const std::string& malenPath, std::string outPath = "")
+		{
+			std::ifstream file(malenPath);
+			if (!file.is_open())
+			{
+				WC_CORE_ERROR("Could not open {}", malenPath);
+				return false;
+			}
+
+			glm::uvec3 size;
+			file >> size.x >> size.y >> size.z;
+			std::vector<TileID> tiles(size_t(size.x) * size.y * size.z, 0);
+			ParseMalenTiles(file, tiles.size(), [&](size_t offset, TileID tile, size_t count) { memset(tiles.data() + offset, tile, count * sizeof(TileID)); });
+			file.close();
+
+			std::string metadata;
+			std::filesystem::path metaFilepath = std::filesystem::path(malenPath).replace_extension("metadata");
+			if (std::filesystem::exists(metaFilepath))
+			{
+				std::ifstream metaFile(metaFilepath, std::ios::binary);
+				metadata.assign(std::istreambuf_iterator<char>(metaFile), std::istreambuf_iterator<char>());
+			}
+			else WC_CORE_WARN("Could not find metadata file for {}", malenPath);
+
+			if (outPath.empty()) outPath = std::filesystem::path(malenPath).replace_extension(LevelExtension).string();
+
+			if (!Write(outPath, size, tiles.data(), metadata)) return false;
+
+			WC_CORE_INFO("Converted {} to {}", malenPath, outPath);
+			return true;
+		}
+
+	private:
+		MappedFile m_File;
+
+		bool Fail()
+		{
+			Close();
+			return false;
+		}
+	};
+}
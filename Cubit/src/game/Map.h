@@ -8,16 +8,24 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <span>
 #include <string>
 #include <vector>
-#include <random>
-
-#include <wc/Math/Camera.h>
+#include "../Profiler.h"
+#include "../Random.h"
 
 #include "ParticleSystem.h"
 #include "Entities.h"
+#include "EntityRegistry.h"
+#include "PlayerInput.h"
 #include "Raycasting.h"
+#include "EntityGrid.h"
+#include "TileOccupancy.h"
+#include "TileRaycast.h"
 #include "Tile.h"
+#include "LevelFile.h"
+#include "TileStorage.h"
+#include "CollisionMesh.h"
 #include <magic_enum.hpp>
 
 // @TODO: Separate tile map and scene
@@ -27,56 +35,45 @@ namespace wc
 
 	Tileset m_Tileset; 
 	
-	RenderData m_RenderData;
-	Renderer2D m_Renderer;
-
-	ParticleSystem m_ParticleEmitter;
 	ParticleProps m_Particle;
 	ParticleProps m_SummonParticle;
 
-	class ContactListener : public b2ContactListener
+	enum class SoundEffect : uint8_t { Gun, Shotgun, SwordSwing, DamageEnemy, Dash };
+
+	struct ParticleBurst
 	{
-		void BulletHit(Entity* entityA, Entity* entityB)
-		{
-			if (entityA->Type == EntityType::Bullet)
-			{
-				Bullet& bullet = *(Bullet*)entityA;
+		ParticleProps Props;
+		uint32_t Amount = 1;
+	};
 
-				bullet.HitEntityType = entityB->Type;
-				bullet.HitEntity = entityB;
-			
-				//if (entityB->Type > EntityType::Entity)
-				//{
-					//entityB->Body->ApplyLinearImpulseToCenter(-bullet.Body->GetLinearVelocity(), true);						
-				//}
-			}
-		}
+	// What the simulation wants heard and seen, collected over one Update. MapView plays and emits it every frame,
+	// headless runs just clear it, so the simulation never touches audio, particles or the camera
+	struct MapEvents
+	{
+		std::vector<SoundEffect> Sounds;
+		std::vector<ParticleBurst> Particles;
+		float CameraShake = 0.f; // Strongest shake asked for
+		bool SwordSwing = false;
 
-		void BulletHitTile(Entity* entityA, Entity* entityB, glm::vec2 normal)
+		void Clear()
 		{
-			if (entityA && entityA->Type == EntityType::Bullet && !entityB)
-			{
-				Bullet& bullet = *(Bullet*)entityA;
-				bullet.HitEntityType = EntityType::Tile;
-
-				if (bullet.Bounces > 0)
-				{
-					bullet.Direction = glm::reflect(bullet.Direction, normal);
-					bullet.Body->SetLinearVelocity(b2Vec2(bullet.Direction.x * WeaponStats[(int)bullet.WeaponType].BulletSpeed, bullet.Direction.y * WeaponStats[(int)bullet.WeaponType].BulletSpeed));
-					bullet.HitEntityType = EntityType::UNDEFINED;
-					bullet.Bounces--;
-				}
-			}
+			Sounds.clear();
+			Particles.clear();
+			CameraShake = 0.f;
+			SwordSwing = false;
 		}
+	};
 
-		void BulletClear(Entity* entity)
+	// Fixtures carry EntityHandles, resolved through the registry of the map whose world is stepping.
+	// Only characters have bodies, bullets are swept by Map::SimulateBullets
+	class ContactListener : public b2ContactListener
+	{
+	public:
+		EntityRegistry* Registry = nullptr;
+	private:
+		Entity* GetEntity(b2Fixture* fixture)
 		{
-			if (entity->Type == EntityType::Bullet)
-			{
-				Bullet& bullet = *(Bullet*)entity;
-				bullet.HitEntityType = EntityType::UNDEFINED;
-				bullet.HitEntity = nullptr;
-			}
+			return Registry->Get(EntityHandle::FromUserData(fixture->GetUserData().pointer));
 		}
 
 		void BeginContact(b2Contact* contact) override
@@ -84,25 +81,13 @@ namespace wc
 			b2Fixture* fixtureA = contact->GetFixtureA();
 			b2Fixture* fixtureB = contact->GetFixtureB();
 
-			b2FixtureUserData fixtureUserDataA = fixtureA->GetUserData();
-			b2FixtureUserData fixtureUserDataB = fixtureB->GetUserData();
-
-			Entity* entityA = reinterpret_cast<Entity*>(fixtureUserDataA.pointer);
-			Entity* entityB = reinterpret_cast<Entity*>(fixtureUserDataB.pointer);
+			Entity* entityA = GetEntity(fixtureA);
+			Entity* entityB = GetEntity(fixtureB);
 							
 			b2Vec2 bNormal = contact->GetManifold()->localNormal;
 			glm::vec2 normal = glm::round(glm::vec2(bNormal.x, bNormal.y));
 
-			if (entityA && entityB)
-			{
-				BulletHit(entityA, entityB);
-				BulletHit(entityB, entityA);
-			}
-
-			BulletHitTile(entityA, entityB, normal);
-			BulletHitTile(entityB, entityA, normal);
-
-			if (entityA && (entityA->Type > EntityType::Entity || entityA->Type == EntityType::Bullet))
+			if (entityA && entityA->Type > EntityType::Entity)
 			{
 				if (fixtureB->GetType() == b2Shape::e_chain)
 				{
@@ -114,7 +99,7 @@ namespace wc
 				}
 			}
 
-			if (entityB && (entityB->Type > EntityType::Entity || entityB->Type == EntityType::Bullet))
+			if (entityB && entityB->Type > EntityType::Entity)
 			{
 				if (fixtureA->GetType() == b2Shape::e_chain)
 				{
@@ -132,18 +117,14 @@ namespace wc
 			b2Fixture* fixtureA = contact->GetFixtureA();
 			b2Fixture* fixtureB = contact->GetFixtureB();
 
-			b2FixtureUserData fixtureUserDataA = fixtureA->GetUserData();
-			b2FixtureUserData fixtureUserDataB = fixtureB->GetUserData();
-
-			Entity* entityA = reinterpret_cast<Entity*>(fixtureUserDataA.pointer);
-			Entity* entityB = reinterpret_cast<Entity*>(fixtureUserDataB.pointer);
+			Entity* entityA = GetEntity(fixtureA);
+			Entity* entityB = GetEntity(fixtureB);
 
 			b2Vec2 bNormal = contact->GetManifold()->localNormal;
 			glm::vec2 normal = glm::round(glm::vec2(bNormal.x, bNormal.y));
 
-			if (entityA && (entityA->Type > EntityType::Entity || entityA->Type == EntityType::Bullet))
+			if (entityA && entityA->Type > EntityType::Entity)
 			{
-				//BulletClear(entityA);
 				if (fixtureB->GetType() == b2Shape::e_chain)
 				{
 					entityA->Contacts--;
@@ -154,9 +135,8 @@ namespace wc
 				}
 			}
 
-			if (entityB && (entityB->Type > EntityType::Entity || entityB->Type == EntityType::Bullet))
+			if (entityB && entityB->Type > EntityType::Entity)
 			{
-				//BulletClear(entityB);
 				if (fixtureA->GetType() == b2Shape::e_chain)
 				{
 					entityB->Contacts--;
@@ -181,12 +161,14 @@ namespace wc
 		void Allocate()
 		{
 			if (IsLoaded()) Free();
-			m_Size = Size.x * Size.y * Size.z;
-			m_Data = new TileID[m_Size];
-			memset(m_Data, 0, sizeof(TileID) * m_Size);
-			if (Entities.size() == 0)
+			m_Tiles.Allocate(Size);
+			m_Occupancy.Allocate(Size);
+			Entities.Bullets.Reserve(BulletPoolCapacity);
+			m_DestroyQueue.reserve(BulletPoolCapacity);
+			if (!player.Handle.IsValid())
 			{
-				Entities.emplace_back(&player);
+				Entities.RegisterPlayer(player);
+				m_EntityGridDirty = true;
 				player.Size = glm::vec2(1.f, 1.f) * 0.5f;
 				player.HitBoxSize = player.Size;
 			}
@@ -194,45 +176,87 @@ namespace wc
 
 		void Free(bool ResetSizes = false)
 		{
-			delete m_Data;
-			m_Data = nullptr;
+			m_Tiles.Free();
+			m_Occupancy.Free();
 
 			if (ResetSizes)
 			{
 				Size.x = 1;
 				Size.y = 1;
 				Size.z = 1;
-				m_Size = 1;
 			}
 
 			DestroyPhysicsWorld();
 
-			if (Entities.size())
+			Entities.Clear();
+			m_EntityGridDirty = true;
+		}
+
+		// Swaps the last entity of the same type into its place, entity references into that pool are invalidated.
+		// Gameplay code goes through QueueDestroy instead, this must not run while the world is stepping
+		void DestroyEntity(EntityHandle handle)
+		{
+			Entity* e = Entities.Get(handle);
+			if (!e) return;
+
+			if (e->Body)
 			{
-				for (uint32_t i = 1; i < Entities.size(); i++) delete Entities[i];
-				Entities.clear();
+				e->Body->DestroyFixture(e->Body->GetFixtureList());
+				PhysicsWorld->DestroyBody(e->Body);
 			}
+
+			Entities.Destroy(handle);
+			m_EntityGridDirty = true;
 		}
 
-		void DestroyEntity(uint32_t i)
-		{
-			auto e = Entities[i];
-			e->Body->DestroyFixture(e->Body->GetFixtureList());
-			PhysicsWorld->DestroyBody(e->Body);
+		void PlaySound(SoundEffect sound) { Events.Sounds.push_back(sound); }
+
+		void EmitParticles(const ParticleProps& props, uint32_t amount = 1) { Events.Particles.push_back({ props, amount }); }
+
+		// Destroyed entities stay in their pools until the end of the fixed step, so pool loops never lose an
+		// entity to a swap and contacts never see a freed body
+		void QueueDestroy(EntityHandle handle) { m_DestroyQueue.push_back(handle); }
 
-			delete e;
-			Entities.erase(Entities.begin() + i);
+		void FlushDestroyQueue()
+		{
+			for (EntityHandle handle : m_DestroyQueue) DestroyEntity(handle);
+			m_DestroyQueue.clear();
 		}
 
-		bool IsLoaded() const { return m_Data != nullptr; }
+		// Grid over the current entity bounds, rebuilt on first use after entities moved, spawned or were destroyed
+		EntityGrid& GetEntityGrid()
+		{
+			if (m_EntityGridSize != glm::uvec2(Size))
+			{
+				// Entities above the open top of the map or pushed out of it end up in the grid's outside list
+				const float margin = 4.f;
+				m_EntityGrid.Init(glm::vec2(-0.5f - margin), glm::vec2(Size) - 0.5f + margin);
+				m_EntityGridSize = Size;
+				m_EntityGridDirty = true;
+			}
 
-		void SetTile(const glm::uvec3& coords, TileID tile) { m_Data[to1D(coords, Size)] = tile; }
+			if (m_EntityGridDirty)
+			{
+				m_GridEntities.clear();
+				Entities.ForEach([&](Entity& entity) { m_GridEntities.push_back(&entity); });
+				m_EntityGrid.Build(m_GridEntities);
+				m_EntityGridDirty = false;
+			}
+			return m_EntityGrid;
+		}
 
-		TileID GetTile(uint32_t id) { return m_Data[id]; }
+		bool IsLoaded() const { return m_Tiles.IsAllocated(); }
 
-		TileID GetTile(const glm::uvec3& coords) { return m_Data[to1D(coords, Size)]; }
+		// Collision of the affected chunks is rebuilt by UpdateTileCollision before the next physics step
+		void SetTile(const glm::uvec3& coords, TileID tile)
+		{
+			m_Tiles.Set(coords, tile);
+			if (coords.z == 0) m_Occupancy.Set(coords.x, coords.y, tile > 0);
+		}
 
-		TileID GetTileSafe(const glm::ivec3& coords)
+		TileID GetTile(const glm::uvec3& coords) const { return m_Tiles.Get(coords); }
+
+		TileID GetTileSafe(const glm::ivec3& coords) const
 		{
 			if (!IsLoaded()) return 0;
 			for (uint32_t i = 0; i < 2; i++) if (coords[i] < 0 || coords[i] >= int(Size[i])) return 0;
@@ -244,719 +268,605 @@ namespace wc
 			AccumulatedTime = 0.f;
 			EnemyCount = 0;
 			LevelTime = 0.f;
-			//stopping sword animation
-			m_RotateSword = false;
-			m_SwordRotation = 0.f;
-
-			m_ParticleEmitter.Reset();
+			Events.Clear();
 
 			//resetting player and timers
 			player.DashCD = 0.2f;
 			player.Health = player.StartHealth;
 			player.DownContacts = 0;
+			player.JumpForce = 0.f;
+			player.MoveDir = 0.f;
+			for (auto& weapon : player.Weapons)
+			{
+				weapon.Timer = 0.f;
+				weapon.AltFireTimer = 0.f;
+				weapon.ReloadTimer = 0.f;
+			}
 		}
 
 		void Load(const std::string& filepath)
 		{
 			Reset();
 
-			std::ifstream file(filepath);
+			Timer timer;
+			timer.Start();
 
-			file >> Size.x >> Size.y >> Size.z;
-			Allocate();
+			if (std::filesystem::path(filepath).extension() == LevelExtension)
+			{
+				LevelFile level;
+				if (!level.Open(filepath)) return;
 
-			std::vector<std::pair<TileID, uint16_t>> data;
+				Size = level.GetSize();
+				Allocate();
+				m_Tiles.CopyFrom(level.Tiles);
+				m_Occupancy.Build(m_Tiles, Size);
 
-			while (!file.eof())
+				if (level.Metadata.size()) LoadMetadata(YAML::Load(std::string(level.Metadata)));
+				else WC_CORE_ERROR("{} has no metadata", filepath);
+			}
+			else
 			{
-				uint32_t block;
-				uint16_t count;
+				std::ifstream file(filepath);
 
-				file >> block >> count;
-				data.emplace_back(block, count);
-			}
+				file >> Size.x >> Size.y >> Size.z;
+				Allocate();
 
-			file.close();
+				ParseMalenTiles(file, size_t(Size.x) * Size.y * Size.z, [&](size_t offset, TileID tile, size_t count) { m_Tiles.Fill(offset, tile, count); });
+				m_Occupancy.Build(m_Tiles, Size);
 
-			Decompress(data);
+				file.close();
 
-			std::filesystem::path filePath(filepath);
-			std::string metaFilepath = filePath.replace_extension("metadata").string();
-			if (std::filesystem::exists(metaFilepath))
-			{
-				YAML::Node mapMetaData = YAML::LoadFile(metaFilepath);
+				std::filesystem::path filePath(filepath);
+				std::string metaFilepath = filePath.replace_extension("metadata").string();
+				if (std::filesystem::exists(metaFilepath)) LoadMetadata(YAML::LoadFile(metaFilepath));
+				else WC_CORE_ERROR("Could not find metadata file for {}", filepath);
+			}
 
-				{
-					auto objects = mapMetaData["Entities"];
-					for (int i = 0; i < objects.size(); i++)
-					{
-						auto metaData = objects[i];
-						EntityType Type = EntityType::UNDEFINED;
-						Type = magic_enum::enum_cast<EntityType>(metaData["Type"].as<std::string>()).value();
+			WC_CORE_INFO("Loaded {} ({}x{}x{}) in {:.3f}ms, {}/{} chunks allocated ({} KB)", filepath, Size.x, Size.y, Size.z, timer.GetElapsedTime() * 1000.f,
+				m_Tiles.GetAllocatedChunkCount(), m_Tiles.GetChunkTotal(), m_Tiles.GetMemoryUsage() / 1024);
+		}
 
-						if (Type == EntityType::Player)
-						{
-							player.Weapons[(int)WeaponType::Blaster].Ammo = 60;
-							player.Weapons[(int)WeaponType::Laser].Ammo = 10;
-							player.Weapons[(int)WeaponType::Shotgun].Ammo = 12;
-							player.Weapons[(int)WeaponType::Revolver].Ammo = 24;
-							player.Weapon = player.PrimaryWeapon;
+		void LoadMetadata(const YAML::Node& mapMetaData)
+		{
+			auto objects = mapMetaData["Entities"];
+			for (int i = 0; i < objects.size(); i++)
+			{
+				auto metaData = objects[i];
+				EntityType Type = EntityType::UNDEFINED;
+				Type = magic_enum::enum_cast<EntityType>(metaData["Type"].as<std::string>()).value();
 
-							for (int i = 0; i < magic_enum::enum_count<WeaponType>(); i++) player.Weapons[i].Magazine = WeaponStats[i].MaxMag;
+				if (Type == EntityType::Player)
+				{
+					player.Weapons[(int)WeaponType::Blaster].Ammo = 60;
+					player.Weapons[(int)WeaponType::Laser].Ammo = 10;
+					player.Weapons[(int)WeaponType::Shotgun].Ammo = 12;
+					player.Weapons[(int)WeaponType::Revolver].Ammo = 24;
+					player.Weapon = player.PrimaryWeapon;
 
-							player.LoadMapBase(metaData);
-						}
-						else if (Type == EntityType::RedCube)
-						{
-							RedCube* e = new RedCube();
-							e->LoadMapBase(metaData);
-							Entities.emplace_back(e);
+					for (int i = 0; i < magic_enum::enum_count<WeaponType>(); i++) player.Weapons[i].Magazine = WeaponStats[i].MaxMag;
 
-							EnemyCount++;
-						}
-						else if (Type == EntityType::Fly)
-						{
-							Fly* e = new Fly();
-							e->LoadMapBase(metaData);
-							Entities.emplace_back(e);
+					player.LoadMapBase(metaData);
+				}
+				else if (Type == EntityType::RedCube)
+				{
+					RedCube e;
+					e.LoadMapBase(metaData);
+					Entities.Create(std::move(e));
+					m_EntityGridDirty = true;
 
-							EnemyCount++;
-						}
-					}
+					EnemyCount++;
 				}
+				else if (Type == EntityType::Fly)
+				{
+					Fly e;
+					e.LoadMapBase(metaData);
+					Entities.Create(std::move(e));
+					m_EntityGridDirty = true;
 
+					EnemyCount++;
+				}
 			}
-			else WC_CORE_ERROR("Could not find metadata file for {}", filepath);
 		}
 
 		void LoadFull(const std::string& filepath) // @TODO: Rename?
 		{
 			Load(filepath);
 			CreatePhysicsWorld();
-
-			camera.Position = glm::vec3(player.Position, 0.f);			
 		}
 
 		float Gravity = -9.8f;
 		void CreatePhysicsWorld()
 		{
 			PhysicsWorld = new b2World({ 0.f, Gravity });
+			ContactListenerInstance.Registry = &Entities;
 			PhysicsWorld->SetContactListener(&ContactListenerInstance);
 
-			b2Vec2 vs[4];
-
-			for (uint32_t i = 0; i < Entities.size(); i++)
-			{
-				Entity* e = (Entity*)Entities[i];
-				e->CreateBody(PhysicsWorld);
-			}
-
-			auto addFace = [&](const b2Vec2* face)
-				{
-					if ((face[0].x == face[1].x && face[1].x == 0.f) && face[0].y == face[1].y && face[1].y == 0.f) return;
-
-					b2ChainShape chain;
-					chain.CreateChain(face, 2, b2Vec2_zero, b2Vec2_zero);
-
-					b2BodyDef bd;
-					bd.type = b2_staticBody;
-					b2Body* body = PhysicsWorld->CreateBody(&bd);
-
-					b2FixtureDef fixtureDef;
-					fixtureDef.shape = &chain;
-					fixtureDef.friction = 0.8f;
+			Entities.ForEachCharacter([&](Entity& entity) { entity.CreateBody(PhysicsWorld); });
 
-					body->CreateFixture(&fixtureDef);
-				};
+			b2BodyDef bd;
+			bd.type = b2_staticBody;
+			TerrainBody = PhysicsWorld->CreateBody(&bd);
 
+			m_ChunkFixtures.assign(m_Tiles.GetChunkTotal(), {});
 
-			// Top/down
-			for (int y = 0; y < (int)Size.y; y++)
+			CollisionStats stats;
+			for (uint32_t chunk = 0; chunk < m_Tiles.GetChunkTotal(); chunk++)
 			{
-				b2Vec2 TopStartPos = { 0.f, 0.f };
-				b2Vec2 TopEndPos = { 0.f, 0.f };
-				bool creatingTopLine = false;
-
-				b2Vec2 BotStartPos = { 0.f, 0.f };
-				b2Vec2 BotEndPos = { 0.f, 0.f };
-				bool creatingBotLine = false;
-
-				for (int x = 0; x < (int)Size.x; x++)
-				{
-					TileID tileID = GetTile({ x, y, 0 });
-					TileID checkTile = 0;
-					if (m_Tileset.Tiles[tileID].Solid)
-					{
-						// Top face
-						checkTile = GetTileSafe({ x, y + 1, 0 });
-						if (!m_Tileset.Tiles[checkTile].Solid)
-						{
-							if (!creatingTopLine)
-							{
-								TopStartPos = { x - 0.5f, y + 0.5f };
-								TopEndPos = { x + 0.5f, y + 0.5f };
-								creatingTopLine = true;
-							}
-							else
-							{
-								TopEndPos.x++;
-							}
-						}
-						else if (creatingTopLine)
-						{
-							creatingTopLine = false;
-							b2Vec2 FACE[2] = { TopEndPos, TopStartPos };
-							addFace(FACE);
-						}
+				BuildChunkCollision(chunk, stats);
+				m_Tiles.ClearDirty(chunk, CHUNK_DIRTY_PHYSICS);
+			}
 
-						// Down face
-						checkTile = GetTileSafe({ x, y - 1, 0 });
-						if (!m_Tileset.Tiles[checkTile].Solid && y - 1 >= 0)
-						{
-							if (!creatingBotLine)
-							{
-								BotStartPos = { x - 0.5f, y - 0.5f };
-								BotEndPos = { x + 0.5f, y - 0.5f };
-								creatingBotLine = true;
-							}
-							else
-							{
-								BotEndPos.x++;
-							}
-						}
-						else if (creatingBotLine)
-						{
-							creatingBotLine = false;
-							b2Vec2 FACE[2] = { BotStartPos, BotEndPos };
-							addFace(FACE);
-						}
-					}
-					else
-					{
-						if (creatingTopLine)
-						{
-							b2Vec2 FACE[2] = { TopEndPos, TopStartPos };
-							addFace(FACE);
-							creatingTopLine = false;
-						}
+			WC_CORE_INFO("Terrain collision: {} faces, {} single segment bodies before merging -> {} segments in {} loops and {} chains on 1 body",
+				stats.Faces, stats.LegacyBodies, stats.Segments, stats.Loops, stats.Chains);
+		}
 
-						if (creatingBotLine)
-						{
-							b2Vec2 FACE[2] = { BotStartPos, BotEndPos };
-							addFace(FACE);
-							creatingBotLine = false;
-						}
-					}
-				}
+		// Regenerates the collision of every chunk touched by SetTile since the last call.
+		// Runs between physics steps because fixtures can't be swapped while the world is locked
+		void UpdateTileCollision()
+		{
+			if (!TerrainBody) return;
 
-				// Close any open top or bottom lines at the end of the row
-				if (creatingTopLine)
-				{
-					b2Vec2 FACE[2] = { TopEndPos, TopStartPos };
-					addFace(FACE);
-					creatingTopLine = false;
-				}
+			CollisionStats stats;
+			m_Tiles.ForEachDirty(CHUNK_DIRTY_PHYSICS, [&](uint32_t chunk) { BuildChunkCollision(chunk, stats); });
+		}
 
-				if (creatingBotLine)
-				{
-					b2Vec2 FACE[2] = { BotStartPos, BotEndPos };
-					addFace(FACE);
-					creatingBotLine = false;
-				}
-			}
+		// Swaps the fixtures of a chunk on TerrainBody, dynamic bodies touching them are woken up by Box2D
+		void BuildChunkCollision(uint32_t chunk, CollisionStats& stats)
+		{
+			auto& fixtures = m_ChunkFixtures[chunk];
+			for (auto fixture : fixtures) TerrainBody->DestroyFixture(fixture);
+			fixtures.clear();
 
-			// Left/right
-			for (int x = 0; x < (int)Size.x; x++)
-			{
-				b2Vec2 LeftStartPos = { 0.f, 0.f };
-				b2Vec2 LeftEndPos = { 0.f, 0.f };
-				bool creatingLeftLine = false;
+			if (m_Tiles.IsChunkEmpty(chunk) || m_Tiles.GetChunkCoords(chunk).z != 0) return;
 
-				b2Vec2 RightStartPos = { 0.f, 0.f };
-				b2Vec2 RightEndPos = { 0.f, 0.f };
-				bool creatingRightLine = false;
+			glm::uvec2 min, max;
+			m_Tiles.GetChunkBounds(chunk, min, max);
 
-				for (int y = 0; y < (int)Size.y; y++)
+			TraceContours(glm::ivec2(min), glm::ivec2(max), glm::ivec2(Size), [&](int x, int y) { return IsCollisionSolid(x, y); },
+				[&](const glm::vec2* points, uint32_t count, bool loop, glm::vec2 prevGhost, glm::vec2 nextGhost)
 				{
-					TileID tileID = GetTileSafe({ x, y, 0 });
-					TileID checkTile = 0;
-					if (m_Tileset.Tiles[tileID].Solid)
-					{
-						// Left face
-						checkTile = GetTileSafe({ x - 1, y, 0 });
-						if (!m_Tileset.Tiles[checkTile].Solid && x - 1 >= 0)
-						{
-							if (!creatingLeftLine)
-							{
-								LeftStartPos = { x - 0.5f, y - 0.5f };
-								LeftEndPos = { x - 0.5f, y + 0.5f };
-								creatingLeftLine = true;
-							}
-							else
-							{
-								LeftEndPos.y++;
-							}
-						}
-						else if (creatingLeftLine)
-						{
-							creatingLeftLine = false;
-							b2Vec2 FACE[2] = { LeftEndPos, LeftStartPos };
-							addFace(FACE);
-						}
-
-						// Right face
-						checkTile = GetTileSafe({ x + 1, y, 0 });
-						if (!m_Tileset.Tiles[checkTile].Solid && x + 1 < (int)Size.x)
-						{
-							if (!creatingRightLine)
-							{
-								RightStartPos = { x + 0.5f, y - 0.5f };
-								RightEndPos = { x + 0.5f, y + 0.5f };
-								creatingRightLine = true;
-							}
-							else
-							{
-								RightEndPos.y++;
-							}
-						}
-						else if (creatingRightLine)
-						{
-							creatingRightLine = false;
-							b2Vec2 FACE[2] = { RightStartPos, RightEndPos };
-							addFace(FACE);
-						}
-					}
-					else
-					{
-						if (creatingLeftLine)
-						{
-							b2Vec2 FACE[2] = { LeftEndPos, LeftStartPos };
-							addFace(FACE);
-							creatingLeftLine = false;
-						}
+					b2ChainShape chain;
+					if (loop) chain.CreateLoop((const b2Vec2*)points, count);
+					else chain.CreateChain((const b2Vec2*)points, count, { prevGhost.x, prevGhost.y }, { nextGhost.x, nextGhost.y });
 
-						if (creatingRightLine)
-						{
-							b2Vec2 FACE[2] = { RightStartPos, RightEndPos };
-							addFace(FACE);
-							creatingRightLine = false;
-						}
-					}
-				}
+					b2FixtureDef fixtureDef;
+					fixtureDef.shape = &chain;
+					fixtureDef.friction = 0.8f;
 
-				// Close any open left or right lines at the end of the column
-				if (creatingLeftLine)
-				{
-					b2Vec2 FACE[2] = { LeftEndPos, LeftStartPos };
-					addFace(FACE);
-					creatingLeftLine = false;
-				}
+					fixtures.push_back(TerrainBody->CreateFixture(&fixtureDef));
+				}, stats);
+		}
 
-				if (creatingRightLine)
-				{
-					b2Vec2 FACE[2] = { RightStartPos, RightEndPos };
-					addFace(FACE);
-					creatingRightLine = false;
-				}
-			}
+		// The map is closed on the sides and the bottom, everything above it is open
+		bool IsCollisionSolid(int x, int y) const
+		{
+			if (y >= int(Size.y)) return false;
+			if (x < 0 || y < 0 || x >= int(Size.x)) return true;
+			return m_Tileset.Tiles[GetTile({ x, y, 0 })].Solid;
 		}
 
-		HitInfo Intersect(const Ray& ray, uint32_t startIndex = 0, EntityType ignoreType = EntityType::UNDEFINED)
+		// Only entities whose EntityTypeBit is in entityTypes are tested, pass 0 to intersect tiles only
+		HitInfo Intersect(const Ray& ray, uint32_t entityTypes = AllEntityTypes, float maxDistance = TileRayMaxDistance)
 		{
 			HitInfo hitInfo;
-			float t = FLT_MAX;
-
-			float fMaxDistance = 36.f;
+			float t = IntersectTiles(m_Occupancy, ray.Origin, ray.Direction, maxDistance, hitInfo.N);
+			hitInfo.Hit = t != FLT_MAX;
 
-			glm::vec2 vRayLength1D;
-			auto& vRayStart = ray.Origin;
-			auto& vRayDir = ray.Direction;
-			auto vRayUnitStepSize = abs(ray.InvDirection);
-			glm::ivec2 vMapCheck = glm::round(vRayStart);
-			glm::ivec2 vMapLastCheck = vMapCheck;
-			glm::ivec2 vStep = glm::ivec2(glm::sign(vRayDir));
+			IntersectEntities(ray, entityTypes, t, hitInfo);
 
-			// Establish Starting Conditions
-			for (int i = 0; i < 2; i++)
-				vRayLength1D[i] = ((vRayDir[i] < 0.f ? (vRayStart[i] - float(vMapCheck[i])) : (float(vMapCheck[i]) - vRayStart[i])) + 0.5f) * vRayUnitStepSize[i];
+			hitInfo.Point = ray.Origin + t * ray.Direction;
+			hitInfo.t = t;
 
-			bool bTileFound = false;
-			float fDistance = 0.f;
-			while (!bTileFound && fDistance < fMaxDistance)
-			{
-				// Walk along shortest path
-				int axis = 0;
-				for (int i = 0; i < 2; i++)
-				{
-					int nextAxis = (i + 1) % 2;
-					if (vRayLength1D[axis] > vRayLength1D[nextAxis]) axis = nextAxis;
-				}
+			return hitInfo;
+		}
 
-				vMapCheck[axis] += vStep[axis];
-				fDistance = vRayLength1D[axis];
-				vRayLength1D[axis] += vRayUnitStepSize[axis];
+		// Intersect for every ray, maxDistances is either empty or holds one distance per ray. The tile walk steps four rays
+		// at once but tile by tile, for a few long rays through open space Intersect's block skipping is faster.
+		// Entities are still tested per ray through the grid
+		void IntersectBatch(std::span<const Ray> rays, std::span<HitInfo> hits, std::span<const float> maxDistances = {}, uint32_t entityTypes = AllEntityTypes)
+		{
+			uint32_t count = (uint32_t)rays.size();
+			m_RayBatch.Resize(count);
+			m_RayDistances.resize(count);
+			m_RayNormals.resize(count);
+			for (uint32_t i = 0; i < count; i++)
+				m_RayBatch.Set(i, rays[i], maxDistances.empty() ? TileRayMaxDistance : maxDistances[i]);
 
-				// Test tile at new test point
-				TileID tileID = GetTile(glm::uvec3(vMapCheck, 0));
-				if (tileID > 0)
-				{
-					hitInfo.Hit = true;
-					t = fDistance;
-					hitInfo.N = glm::vec2(vMapLastCheck - vMapCheck);
-					bTileFound = true;
-				}
-				vMapLastCheck = vMapCheck;
-			}
+			IntersectTiles(m_Occupancy, m_RayBatch, m_RayDistances.data(), m_RayNormals.data());
 
-			for (uint32_t i = startIndex; i < Entities.size(); i++)
+			for (uint32_t i = 0; i < count; i++)
 			{
-				auto& entity = *Entities[i];
-				if (entity.Type != ignoreType) {
-					auto oHitInfo = aabbIntersection(ray, -entity.Size + entity.Position, entity.Size + entity.Position);
+				HitInfo& hitInfo = hits[i];
+				hitInfo = HitInfo();
 
-					if (oHitInfo.Hit && oHitInfo.t < t)
-					{
-						hitInfo.Hit = true;
-						t = oHitInfo.t;
-						hitInfo.Entity = Entities[i];
-						hitInfo.N = oHitInfo.N;
-						hitInfo.Point = oHitInfo.Point;
-					}
-				}
-			}
+				float t = m_RayDistances[i];
+				hitInfo.Hit = t != FLT_MAX;
+				if (hitInfo.Hit) hitInfo.N = m_RayNormals[i];
 
-			hitInfo.Point = ray.Origin + t * ray.Direction;
-			hitInfo.t = t;
+				IntersectEntities(rays[i], entityTypes, t, hitInfo);
 
-			return hitInfo;
+				hitInfo.Point = rays[i].Origin + t * rays[i].Direction;
+				hitInfo.t = t;
+			}
 		}
 
+		// Only tiles are considered, entities never block the view
+		bool HasLineOfSight(glm::vec2 from, glm::vec2 to) const { return !IsSegmentBlocked(m_Occupancy, from, to); }
+
 		void Explode(glm::vec2 position, float radius, float blastPower)
 		{
-			for (auto& en : Entities)
-			{
-				auto& e = *en;
-				float dist = glm::distance(position, e.Position);
-
-				if (dist <= radius)
+			GetEntityGrid().QueryRadius(position, radius, [&](uint32_t i)
 				{
-					float invDistance = 1.f / dist;
-					glm::vec2 dir = glm::normalize(e.Position - position) * blastPower * invDistance * invDistance;
-					if (e.Type != EntityType::Bullet) e.Body->ApplyLinearImpulse(b2Vec2{ dir.x, dir.y }, b2Vec2{ position.x, position.y }, true);
-				}
-			}
+					auto& e = *m_GridEntities[i];
+					float dist = glm::distance(position, e.Position);
+
+					if (dist <= radius)
+					{
+						float invDistance = 1.f / dist;
+						glm::vec2 dir = glm::normalize(e.Position - position) * blastPower * invDistance * invDistance;
+						if (e.Type != EntityType::Bullet) e.Body->ApplyLinearImpulse(b2Vec2{ dir.x, dir.y }, b2Vec2{ position.x, position.y }, true);
+					}
+				});
 		}
 
-		void SpawnBullet(glm::vec2 position, glm::vec2 direction, WeaponType weaponType, Entity* src)
+		EntityHandle SpawnBullet(glm::vec2 position, glm::vec2 direction, WeaponType weaponType, EntityHandle src)
 		{
 			auto& weaponInfo = WeaponStats[(int)weaponType];
-			Bullet* bullet = new Bullet();
-			bullet->SourceEntity = src;
-			bullet->Position = position;
-			bullet->Size = weaponInfo.BulletSize;
-			//bullet->Speed = weaponInfo.BulletSpeed;
-			bullet->Direction = direction;
-			bullet->Color = weaponInfo.BulletColor;
-			bullet->BulletType = weaponInfo.BulletType;
-			bullet->WeaponType = weaponType;
-			//bullet->Density = 0.f;
-			//bullet->LinearDamping = 0.f;
-			bullet->Bounces = weaponInfo.BulletBounces;
-
-			{
-				b2BodyDef bodyDef;
-				bodyDef.type = b2_dynamicBody;
-				bodyDef.position.Set(bullet->Position.x, bullet->Position.y);
-				bodyDef.fixedRotation = true;
-				bodyDef.bullet = true;
-				bodyDef.gravityScale = 0.f;
-				bodyDef.linearVelocity = b2Vec2(bullet->Direction.x * weaponInfo.BulletSpeed, bullet->Direction.y * weaponInfo.BulletSpeed);
-				bullet->Body = PhysicsWorld->CreateBody(&bodyDef);
-
-				b2CircleShape shape;
-				shape.m_radius = bullet->Size.x;
-
-				b2FixtureDef fixtureDef;
-				fixtureDef.density = 0.01f;
-				fixtureDef.friction = 0.f;
-				fixtureDef.isSensor = weaponInfo.IsBulletSensor;
-
-				fixtureDef.userData.pointer = (uintptr_t)bullet;
-
-				fixtureDef.shape = &shape;
-				bullet->Body->CreateFixture(&fixtureDef);
-				b2MassData massData;
-				massData.center = bullet->Body->GetMassData().center;
-				massData.I = bullet->Body->GetMassData().I;
-				massData.mass = 0.01f;
-				bullet->Body->SetMassData(&massData);
-			}
-			Entities.emplace_back(bullet);
+			Bullet newBullet;
+			newBullet.SourceEntity = src;
+			newBullet.Position = position;
+			newBullet.PreviousPosition = position;
+			newBullet.Size = weaponInfo.BulletSize;
+			//newBullet.Speed = weaponInfo.BulletSpeed;
+			newBullet.Direction = direction;
+			newBullet.Color = weaponInfo.BulletColor;
+			newBullet.BulletType = weaponInfo.BulletType;
+			newBullet.WeaponType = weaponType;
+			//newBullet.Density = 0.f;
+			//newBullet.LinearDamping = 0.f;
+			newBullet.Bounces = weaponInfo.BulletBounces;
+
+			EntityHandle handle = Entities.Create(std::move(newBullet));
+			m_EntityGridDirty = true;
+			return handle;
 		}
 
 		void DestroyPhysicsWorld()
 		{
+			m_DestroyQueue.clear();
 			delete PhysicsWorld;
 			PhysicsWorld = nullptr;
+			TerrainBody = nullptr;
+			m_ChunkFixtures.clear();
 		}
 
-		void UpdateAI()
+		void UpdateAI(float deltaTime)
 		{
-			for (uint32_t i = 1; i < Entities.size(); i++)
+			for (auto& entity : Entities.RedCubes)
+				if (entity.AttackTimer > 0.f) entity.AttackTimer -= deltaTime;
+
+			for (auto& entity : Entities.Flies)
 			{
-				auto& e = Entities[i];
+				entity.Body->SetGravityScale(0.f);
 
-				e->ID = i;
-				switch (e->Type)
-				{
-				case EntityType::RedCube:
-				{
-					RedCube& entity = *(RedCube*)e;
+				if (entity.AttackTimer > 0.f) entity.AttackTimer -= deltaTime;
+			}
+		}
 
-					if (entity.AttackTimer > 0.f) entity.AttackTimer -= Globals.deltaTime;
+		void UpdateAIFixed()
+		{
+			for (auto& entity : Entities.RedCubes)
+			{
+				if (!entity.Alive())
+				{
+					EnemyCount--;
+					QueueDestroy(entity.Handle);
+					continue;
 				}
-				break;
 
-				case EntityType::Fly:
+				//movement
+				float distToPlayer = glm::distance(player.Position, entity.Position);
+				if (distToPlayer < entity.DetectRange && false)
 				{
-					Fly& entity = *(Fly*)e;
-
-					entity.Body->SetGravityScale(0.f);
-
-					if (entity.AttackTimer > 0.f) entity.AttackTimer -= Globals.deltaTime;
+					if (entity.Position.x > player.Position.x) entity.Body->ApplyLinearImpulseToCenter(b2Vec2(-EntityStats[(int)entity.Type].Speed, 0), true);
+					else entity.Body->ApplyLinearImpulseToCenter(b2Vec2(EntityStats[(int)entity.Type].Speed, 0), true);
 				}
-				break;
-
-				case EntityType::Bullet:
+				//attack behavior
+				if (distToPlayer < entity.ShootRange)
 				{
+					if (entity.AttackTimer <= 0)
+					{
+						//shoot
+						glm::vec2 dir = glm::normalize(player.Position - entity.Position);
+						SpawnBullet(entity.Position + dir * 0.5f, dir, WeaponType::RedBlaster, entity.Handle);
 
-				}
-				break;
-				default:
-					break;
+						entity.AttackTimer = 2.f;
+					}
 				}
 			}
-		}
 
-		void UpdateAIFixed()
-		{
-			for (uint32_t i = 0; i < Entities.size(); i++)
+			for (auto& entity : Entities.Flies)
 			{
-				auto& e = Entities[i];
-				
-				switch (e->Type)
+				entity.Body->SetGravityScale(0.f);
+
+				if (!entity.Alive())
 				{
-				case EntityType::RedCube:
+					EnemyCount--;
+					QueueDestroy(entity.Handle);
+					continue;
+				}
+
+				//movement
+				float distToPlayer = glm::distance(player.Position, entity.Position);
+				if (distToPlayer < entity.DetectRange)
 				{
-					RedCube& entity = *(RedCube*)e;	
+					if (entity.Position.x > player.Position.x) entity.Body->ApplyLinearImpulseToCenter(b2Vec2(-EntityStats[(int)entity.Type].Speed, 0), true);
+					else entity.Body->ApplyLinearImpulseToCenter(b2Vec2(EntityStats[(int)entity.Type].Speed, 0), true);
 
-					if (!entity.Alive())
+				}
+				//attack behavior
+				if (distToPlayer < entity.ShootRange)
+				{
+					if (entity.AttackTimer <= 0)
 					{
-						EnemyCount--;
-						DestroyEntity(i);
+						WC_CORE_INFO("Fly Attack");
 					}
+				}
+			}
 
-					//movement
-					float distToPlayer = glm::distance(player.Position, entity.Position);
-					if (distToPlayer < entity.DetectRange && false)
-					{
-						if (entity.Position.x > player.Position.x) entity.Body->ApplyLinearImpulseToCenter(b2Vec2(-EntityStats[(int)entity.Type].Speed, 0), true);
-						else entity.Body->ApplyLinearImpulseToCenter(b2Vec2(EntityStats[(int)entity.Type].Speed, 0), true);
-					}
-					//attack behavior
-					if (distToPlayer < entity.ShootRange)
+			SimulateBullets();
+			for (auto& bullet : Entities.Bullets)
+			{
+				WeaponInfo& weapon = WeaponStats[(int)bullet.WeaponType];
+				bullet.DistanceTraveled += weapon.BulletSpeed * SimulationTime;
+				bool destroy = false;
+
+				// The entity hit during the last step may have been destroyed since
+				Entity* shotEnt = Entities.Get(bullet.HitEntity);
+				if (bullet.HitEntityType > EntityType::UNDEFINED && !shotEnt) bullet.HitEntityType = EntityType::UNDEFINED;
+
+				if (bullet.HitEntityType > EntityType::UNDEFINED)
+				{
+					if (bullet.BulletType == BulletType::RedCircle && bullet.HitEntityType == EntityType::Player)
 					{
-						if (entity.AttackTimer <= 0 && entity.Alive())
+						if (GetRandom().NextBool())
 						{
-							//shoot
-							glm::vec2 dir = glm::normalize(player.Position - entity.Position);
-							SpawnBullet(entity.Position + dir * 0.5f, dir, WeaponType::RedBlaster, e);
+							RedCube em;
+							em.Position = bullet.Position + glm::vec2(0.f, 1.f);
+							Entities.Get<RedCube>(Entities.Create(std::move(em)))->CreateBody(PhysicsWorld);
+
+							m_SummonParticle.Position = bullet.Position + glm::vec2(0.f, 1.f);
+							m_SummonParticle.Velocity = glm::vec2(0.5f);
+							for (int i = 0; i < 6; i++)
+							{
+								m_SummonParticle.VelocityVariation = glm::normalize(glm::vec3{ RandomValue(), RandomValue(), RandomValue() });
 
-							entity.AttackTimer = 2.f;
+								EmitParticles(m_SummonParticle);
+							}
+							EnemyCount++;
+							m_EntityGridDirty = true;
 						}
+
+						PlaySound(SoundEffect::DamageEnemy);
+						player.DealDamage(weapon.Damage);
 					}
-				}
-				break;
 
-				case EntityType::Fly: 
-				{
-					Fly& entity = *(Fly*)e;
+					if (bullet.HitEntityType > EntityType::Entity)
+					{
+						if (bullet.BulletType == BulletType::Blaster)
+						{
+							if (bullet.HitEntity != bullet.SourceEntity) {
+								shotEnt->DealDamage(weapon.Damage);
+								PlaySound(SoundEffect::DamageEnemy);
+							}
 
-					entity.Body->SetGravityScale(0.f);
+							m_Particle.LifeTime = 0.35f;
+							m_Particle.ColorBegin = glm::vec4(0.f, 1.f, 0.f, 1.f) * 2.f;
+							m_Particle.ColorEnd = glm::vec4(0.f, 1.f, 0.f, 1.f);
+							m_Particle.Position = bullet.Position;
+							m_Particle.Velocity = glm::vec2(0.5f);
+							m_Particle.VelocityVariation = glm::normalize(shotEnt->Position - player.Position) * 2.5f;
+							EmitParticles(m_Particle, 6);
+						}
 
-					if (!entity.Alive())
-					{
-						EnemyCount--;
-						DestroyEntity(i);
-					}
+						if (bullet.BulletType == BulletType::Shotgun)
+						{
+							if (bullet.HitEntity != bullet.SourceEntity)shotEnt->DealDamage(weapon.Damage);
+						}
 
-					//movement
-					float distToPlayer = glm::distance(player.Position, entity.Position);
-					if (distToPlayer < entity.DetectRange)
-					{
-						if (entity.Position.x > player.Position.x) entity.Body->ApplyLinearImpulseToCenter(b2Vec2(-EntityStats[(int)entity.Type].Speed, 0), true);
-						else entity.Body->ApplyLinearImpulseToCenter(b2Vec2(EntityStats[(int)entity.Type].Speed, 0), true);
+						if (bullet.BulletType == BulletType::Revolver)
+						{
+							if (bullet.HitEntity != bullet.SourceEntity)shotEnt->DealDamage(weapon.Damage);
+						}
 
+						if (bullet.HitEntity == bullet.SourceEntity && bullet.Bounces != WeaponStats[(int)bullet.WeaponType].BulletBounces)destroy = true;
 					}
-					//attack behavior
-					if (distToPlayer < entity.ShootRange)
-					{
-						if (entity.AttackTimer <= 0 && entity.Alive())
+					
+
+					if (!bullet.IsSensor() && shotEnt->Type == EntityType::Bullet) {
+						Bullet& hitBullet = *(Bullet*)shotEnt;
+						if (!hitBullet.IsSensor())
 						{
-							WC_CORE_INFO("Fly Attack");
+							//animation
+							m_Particle.LifeTime = 0.45f;
+							m_Particle.ColorBegin = bullet.Color;
+							m_Particle.ColorEnd = hitBullet.Color;
+							m_Particle.Position = bullet.Position;
+							m_Particle.Velocity = glm::vec2(0.0f);
+							m_Particle.VelocityVariation = glm::vec2(0.0f);
+							EmitParticles(m_Particle, 6);
+							destroy = true;
 						}
 					}
-
+					else if (bullet.HitEntity != bullet.SourceEntity && shotEnt->Type != EntityType::Bullet) 
+					{
+						destroy = true;
+					}						
 				}
-				break;
-
-				case EntityType::Bullet:
+				else 
 				{
-					Bullet& bullet = *(Bullet*)e;
-					WeaponInfo& weapon = WeaponStats[(int)bullet.WeaponType];
-					bullet.DistanceTraveled += weapon.BulletSpeed * SimulationTime;
-					bool destroy = false;
-					if (bullet.HitEntityType > EntityType::UNDEFINED)
-					{
-						Entity* shotEnt = bullet.HitEntity;
-
-						if (bullet.BulletType == BulletType::RedCircle && bullet.HitEntityType == EntityType::Player)
-						{
-							std::random_device rd;
-							std::mt19937 gen(rd());
-							std::uniform_int_distribution<> dis(0, 1); // Define the range
+					if (bullet.HitEntityType == EntityType::Tile && bullet.Bounces == 0) destroy = true;
+				}
+				
+				if (bullet.DistanceTraveled > weapon.Range) destroy = true;
+				if (bullet.Position.x <= 0.f || bullet.Position.x >= Size.x + 1.f ||
+					bullet.Position.y <= 0.f || bullet.Position.y >= Size.y + 1.f) destroy = true;
+				
+				if (destroy) QueueDestroy(bullet.Handle);
+			}
+		}
 
-							if (dis(gen) == 0)
-							{
-								RedCube* em = new RedCube();
-								em->Position = bullet.Position + glm::vec2(0.f, 1.f);
-								em->CreateBody(PhysicsWorld);
-
-								m_SummonParticle.Position = em->Position;
-								m_SummonParticle.Velocity = glm::vec2(0.5f);
-								for (int i = 0; i < 6; i++)
-								{
-									m_SummonParticle.VelocityVariation = glm::normalize(glm::vec3(RandomValue(), RandomValue(), RandomValue()));
-
-									m_ParticleEmitter.Emit(m_SummonParticle);
-								}
-								EnemyCount++;
-								Entities.emplace_back(em);
-							}
+		// Bullets have no bodies. Every fixed step each one is swept as a segment against the tiles and against the
+		// entity boxes grown by its radius, in the grid cells around the segment. Tile hits reflect the bullet while it
+		// has bounces left, the first hit that stops it is left in HitEntity for UpdateAIFixed.
+		// Tiles are hit by the bullet's center and outside of the map is open, bullets leaving it are destroyed.
+		// The grid holds the boxes from before the pass, which stay right for characters but not for bullets moved
+		// earlier in it. Only solid bullets collide with each other and few weapons fire them, so bullets are left out
+		// of the grid queries and solid ones are swept directly against the current positions of the others
+		void SimulateBullets()
+		{
+			m_SolidBullets.clear();
+			for (auto& bullet : Entities.Bullets)
+			{
+				bullet.PreviousPosition = bullet.Position;
+				bullet.HitEntityType = EntityType::UNDEFINED;
+				bullet.HitEntity = EntityHandle();
+				if (!bullet.IsSensor()) m_SolidBullets.push_back(&bullet);
+			}
 
-							ma_sound_start(&Globals.damageEnemy);
-							player.DealDamage(weapon.Damage);
-						}
+			EntityGrid& grid = GetEntityGrid();
+			for (auto& bullet : Entities.Bullets)
+			{
+				if (bullet.HitEntityType != EntityType::UNDEFINED) continue; // Hit by another bullet earlier in this step
 
-						if (bullet.HitEntityType > EntityType::Entity)
+				float radius = bullet.Size.x;
+				float remaining = WeaponStats[(int)bullet.WeaponType].BulletSpeed * SimulationTime;
+				while (true)
+				{
+					Ray ray(bullet.Position, bullet.Direction);
+					glm::vec2 normal;
+					float tileT = IntersectTiles(m_Occupancy, ray.Origin, ray.Direction, remaining, normal);
+					float end = glm::min(tileT, remaining);
+
+					// A bullet standing still is still hit by entities walking into it
+					Entity* hitEntity = nullptr;
+					glm::vec2 segmentEnd = ray.Origin + ray.Direction * end;
+					grid.QueryBox(glm::min(ray.Origin, segmentEnd) - radius, glm::max(ray.Origin, segmentEnd) + radius, [&](uint32_t i)
 						{
-							if (bullet.BulletType == BulletType::Blaster)
-							{
-								if (shotEnt != bullet.SourceEntity) {
-									shotEnt->DealDamage(weapon.Damage);
-									ma_sound_start(&Globals.damageEnemy);
-								}
-
-								m_Particle.LifeTime = 0.35f;
-								m_Particle.ColorBegin = glm::vec4(0.f, 1.f, 0.f, 1.f) * 2.f;
-								m_Particle.ColorEnd = glm::vec4(0.f, 1.f, 0.f, 1.f);
-								m_Particle.Position = bullet.Position;
-								m_Particle.Velocity = glm::vec2(0.5f);
-								m_Particle.VelocityVariation = glm::normalize(shotEnt->Position - player.Position) * 2.5f;
-								m_ParticleEmitter.Emit(m_Particle, 6);
-							}
-
-							if (bullet.BulletType == BulletType::Shotgun)
-							{
-								if (shotEnt != bullet.SourceEntity)shotEnt->DealDamage(weapon.Damage);
-							}
+							Entity& entity = *m_GridEntities[i];
+							if (entity.Type == EntityType::Bullet || !CanBulletHit(bullet, entity)) return;
 
-							if (bullet.BulletType == BulletType::Revolver)
+							HitInfo hit = aabbIntersection(ray, entity.Position - entity.Size - radius, entity.Position + entity.Size + radius);
+							float t = hit.Inside ? 0.f : hit.t;
+							if (hit.Hit && t <= end)
 							{
-								if (shotEnt != bullet.SourceEntity)shotEnt->DealDamage(weapon.Damage);
+								end = t;
+								hitEntity = &entity;
 							}
+						});
 
-							if (bullet.HitEntity == bullet.SourceEntity && bullet.Bounces != WeaponStats[(int)bullet.WeaponType].BulletBounces)destroy = true;
-						}
-						
+					// Bullets that already hit something in this step are gone
+					if (!bullet.IsSensor())
+						for (Bullet* other : m_SolidBullets)
+						{
+							if (other == &bullet || other->HitEntityType != EntityType::UNDEFINED || !CanBulletHit(bullet, *other)) continue;
 
-						if (!bullet.IsSensor() && bullet.HitEntity->Type == EntityType::Bullet) {
-							Bullet& hitBullet = *(Bullet*)bullet.HitEntity;
-							if (!hitBullet.IsSensor())
+							HitInfo hit = aabbIntersection(ray, other->Position - other->Size - radius, other->Position + other->Size + radius);
+							float t = hit.Inside ? 0.f : hit.t;
+							if (hit.Hit && t <= end)
 							{
-								//animation
-								m_Particle.LifeTime = 0.45f;
-								m_Particle.ColorBegin = bullet.Color;
-								m_Particle.ColorEnd = hitBullet.Color;
-								m_Particle.Position = bullet.Position;
-								m_Particle.Velocity = glm::vec2(0.0f);
-								m_Particle.VelocityVariation = glm::vec2(0.0f);
-								m_ParticleEmitter.Emit(m_Particle, 6);
-								destroy = true;
+								end = t;
+								hitEntity = other;
 							}
 						}
-						else if (shotEnt != bullet.SourceEntity && bullet.HitEntity->Type != EntityType::Bullet) 
+
+					if (hitEntity)
+					{
+						bullet.Position = ray.Origin + ray.Direction * end;
+						bullet.HitEntityType = hitEntity->Type;
+						bullet.HitEntity = hitEntity->Handle;
+						if (hitEntity->Type == EntityType::Bullet)
 						{
-							destroy = true;
-						}						
+							Bullet& hitBullet = static_cast<Bullet&>(*hitEntity);
+							hitBullet.HitEntityType = EntityType::Bullet;
+							hitBullet.HitEntity = bullet.Handle;
+						}
+						break;
 					}
-					else 
+
+					if (tileT > remaining)
 					{
-						if (bullet.HitEntityType == EntityType::Tile && bullet.Bounces == 0) destroy = true;
+						bullet.Position = segmentEnd;
+						break;
 					}
-					
-					if (bullet.DistanceTraveled > weapon.Range) destroy = true;
-					if (bullet.Position.x <= 0.f || bullet.Position.x >= Size.x + 1.f ||
-						bullet.Position.y <= 0.f || bullet.Position.y >= Size.y + 1.f) destroy = true;
-					
-					if (destroy) DestroyEntity(i);
-					
-				}
-				break;
-				default:
-					break;
+
+					// Pulled back out of the hit tile so the next sweep starts in front of it
+					bullet.Position = ray.Origin + ray.Direction * tileT + normal * 0.001f;
+					remaining -= tileT;
+					if (bullet.Bounces == 0)
+					{
+						bullet.HitEntityType = EntityType::Tile;
+						break;
+					}
+					bullet.Direction = glm::reflect(bullet.Direction, normal);
+					bullet.Bounces--;
 				}
 			}
+			m_EntityGridDirty = true;
+		}
+
+		bool CanBulletHit(Bullet& bullet, Entity& entity) const
+		{
+			if (entity.Handle == bullet.Handle) return false;
+
+			// Bullets start inside of their shooter, they can only come back to it after a bounce
+			if (entity.Handle == bullet.SourceEntity && bullet.Bounces == WeaponStats[(int)bullet.WeaponType].BulletBounces) return false;
+
+			// Only two solid bullets destroy each other, every other pair passes through
+			if (entity.Type == EntityType::Bullet) return !bullet.IsSensor() && !static_cast<Bullet&>(entity).IsSensor();
+			return true;
 		}
 
 		void FixedUpdate()
 		{
+			WC_PROFILE_SCOPE("Map::FixedUpdate");
+
 			if (player.MoveDir != 0.f)
 				player.Body->ApplyLinearImpulseToCenter({ player.MoveDir * EntityStats[(int)EntityType::Player].Speed * player.Body->GetMass() / 10.f * (player.DownContacts > 0 ? 1.f : AirSpeedFactor), 0.f}, true);
 
 			UpdateAIFixed();
+			FlushDestroyQueue();
 		}
 
-		void InputGame()
+		// Simulation side of the player's input, sounds, particles and the camera shake only go into Events
+		void ApplyInput(const PlayerInput& input, float deltaTime)
 		{
-			if (ImGui::IsKeyDown((ImGuiKey)Globals.settings.KeyLeft)) player.MoveDir = -1.f;
-			else if (ImGui::IsKeyDown((ImGuiKey)Globals.settings.KeyRight)) player.MoveDir = 1.f;
-			else player.MoveDir = 0.f;
+			player.MoveDir = input.MoveDir;
 
 			if (player.MoveDir != 0.f)
 			{
-				if (Key::GetKey(Key::LeftShift) == GLFW_PRESS && player.DashCD <= 0.f)
+				if (input.Dash && player.DashCD <= 0.f)
 				{
-					ma_engine_play_sound(&Globals.sfx_engine, "assets/sound/sfx/dash.wav", NULL);
+					PlaySound(SoundEffect::Dash);
 					player.Body->ApplyLinearImpulseToCenter({ 50.f * player.Body->GetMass() * player.MoveDir, 0.f }, true);
 					player.DashCD = 2.f;
 				}
 			}
 
-			if (ImGui::IsKeyReleased((ImGuiKey)Globals.settings.KeyFastSwich))
+			if (input.SwitchWeapon)
 			{
 				if (player.Weapon == player.PrimaryWeapon) player.Weapon = player.SecondaryWeapon;
 				else player.Weapon = player.PrimaryWeapon;
 			}
 
-			if (ImGui::IsKeyPressed((ImGuiKey)Globals.settings.KeyMainWeapon))
+			if (input.SelectPrimary)
 				player.Weapon = player.PrimaryWeapon;
 
-			else if (ImGui::IsKeyPressed((ImGuiKey)Globals.settings.KeySecondaryWeapon))
+			else if (input.SelectSecondary)
 				player.Weapon = player.SecondaryWeapon;
 
 
-			if (ImGui::IsKeyPressed((ImGuiKey)Globals.settings.KeyJump) && player.DownContacts != 0)
+			if (input.Jump && player.DownContacts != 0)
 			{
 				// @NOTE: if gravity is changed we should update this
 				float jumHeight = 8.f;
@@ -971,7 +881,7 @@ namespace wc
 
 				player.Body->SetGravityScale(1.f);
 
-				vel.x -= DragStrength * vel.x * Globals.deltaTime;
+				vel.x -= DragStrength * vel.x * deltaTime;
 
 				if (abs(vel.x) < 0.01f) vel.x = 0.f;
 
@@ -981,45 +891,29 @@ namespace wc
 			if (player.Body->GetLinearVelocity().y < 0.f) player.Body->SetGravityScale(2.5f);
 
 
-			glm::vec2 dir = glm::normalize(glm::vec2(camera.Position) + m_Renderer.ScreenToWorld(Globals.window.GetCursorPos()) - player.Position);
+			glm::vec2 dir = input.Aim;
 			
-			bool Zoom = WeaponStats[(int)player.Weapon].CanZoom && Mouse::GetMouse(Mouse::RIGHT) != GLFW_RELEASE;
-
-			m_TargetRotation = 0.f;
-			if (Zoom)
-			{
-				//auto offset = dir * 8.f;
-				//offset.y = glm::clamp(offset.y, -3.f, 3.f);
-				m_TargetPosition = player.Position + dir * 3.f;
-				m_TargetZoom = 0.6f;
-			}
-			else
-			{
-				m_TargetPosition = player.Position;
-				m_TargetZoom = 1.f;
-			}
+			bool Zoom = WeaponStats[(int)player.Weapon].CanZoom && input.AltFire;
 
-			if (ImGui::IsKeyPressed(ImGuiKey_R))player.ReloadWeapon();
+			if (input.Reload) player.ReloadWeapon();
 
-			if (ImGui::IsMouseDown(ImGuiMouseButton_Left) && player.CanShoot())
+			if (input.Fire && player.CanShoot())
 			{
 				if (player.Weapon == WeaponType::Blaster)
 				{
-					std::random_device rd;
-					std::mt19937 gen(rd());
+					auto& random = GetRandom();
 					auto& offset = WeaponStats[(int)WeaponType::Blaster].Recoil;
-					std::uniform_real_distribution<float> dis(offset.x, offset.y);
 
-					ma_sound_start(&Globals.gun);
+					PlaySound(SoundEffect::Gun);
 
-					SpawnBullet(player.Position + dir * 0.5f, Zoom ? dir : RandomOnHemisphere(dir, glm::normalize(dir + glm::vec2(dis(gen), dis(gen)))), player.Weapon, (Entity*)&player);
+					SpawnBullet(player.Position + dir * 0.5f, Zoom ? dir : RandomOnHemisphere(dir, glm::normalize(dir + random.RangeVec2(offset.x, offset.y))), player.Weapon, player.Handle);
 				}
 				else if (player.Weapon == WeaponType::Laser) {
 
-					ma_sound_start(&Globals.gun);
+					PlaySound(SoundEffect::Gun);
 
 					glm::vec2 shootPos = player.Position + dir * 0.35f;
-					auto hitInfo = Intersect({ shootPos, dir }, 1, EntityType::Bullet);
+					auto hitInfo = Intersect({ shootPos, dir }, AllEntityTypes & ~(EntityTypeBit(EntityType::Player) | EntityTypeBit(EntityType::Bullet)));
 
 					if (glm::distance(hitInfo.Point, player.Position) < WeaponStats[(int)WeaponType::Laser].Range) {
 						if (hitInfo.Hit && hitInfo.Entity) {
@@ -1032,15 +926,15 @@ namespace wc
 						m_Particle.ColorEnd = { 254 / 255.0f, 109 / 255.0f, 41 / 255.0f, 1.0f };
 						m_Particle.Velocity = -dir;
 						m_Particle.VelocityVariation = -dir * 3.5f;
-						m_ParticleEmitter.Emit(m_Particle, 25);
+						EmitParticles(m_Particle, 25);
 					}
 				}
 				else if (player.Weapon == WeaponType::Shotgun)
 				{
-					camera.Shake(0.8f);
+					Events.CameraShake = glm::max(Events.CameraShake, 0.8f);
 
 					glm::vec2 shootPos = player.Position + dir * 0.5f;
-					auto hitInfo = Intersect({ shootPos, dir }, 1);
+					auto hitInfo = Intersect({ shootPos, dir }, AllEntityTypes & ~EntityTypeBit(EntityType::Player));
 
 					if (hitInfo.t <= 5.f)
 					{
@@ -1049,34 +943,30 @@ namespace wc
 						player.Body->ApplyLinearImpulseToCenter({ recoilForce.x, recoilForce.y }, true);
 					}
 
-					ma_sound_start(&Globals.shotgun);
-					std::random_device rd;
-					std::mt19937 gen(rd());
+					PlaySound(SoundEffect::Shotgun);
+					auto& random = GetRandom();
 					auto& offset = WeaponStats[(int)WeaponType::Shotgun].Recoil;
-					std::uniform_real_distribution<float> dis(offset.x, offset.y);
 
 					for (uint32_t i = 0; i < 10; i++)
 					{
-						SpawnBullet(shootPos, RandomOnHemisphere(dir, glm::normalize(dir + glm::vec2(dis(gen), dis(gen)))), player.Weapon, (Entity*)&player);
+						SpawnBullet(shootPos, RandomOnHemisphere(dir, glm::normalize(dir + random.RangeVec2(offset.x, offset.y))), player.Weapon, player.Handle);
 
 						m_Particle.Position = player.Position + dir * 0.55f;
 						auto& vel = player.Body->GetLinearVelocity();
 						m_Particle.ColorBegin = glm::vec4{ 254 / 255.0f, 212 / 255.0f, 123 / 255.0f, 1.0f } *2.f;
 						m_Particle.ColorEnd = { 254 / 255.0f, 109 / 255.0f, 41 / 255.0f, 1.0f };
 						m_Particle.Velocity = glm::vec2(vel.x, vel.y) * 0.45f;
-						m_Particle.VelocityVariation = glm::normalize(player.Position + RandomOnHemisphere(dir, glm::normalize(dir + glm::vec2(dis(gen), dis(gen)))) * 0.85f - player.Position) * 5.f;
-						m_ParticleEmitter.Emit(m_Particle, 5);
+						m_Particle.VelocityVariation = glm::normalize(player.Position + RandomOnHemisphere(dir, glm::normalize(dir + random.RangeVec2(offset.x, offset.y))) * 0.85f - player.Position) * 5.f;
+						EmitParticles(m_Particle, 5);
 					}
 				}
 				else if (player.Weapon == WeaponType::Revolver)
 				{
-					std::random_device rd;
-					std::mt19937 gen(rd());
+					auto& random = GetRandom();
 					auto& offset = WeaponStats[(int)WeaponType::Revolver].Recoil;
-					std::uniform_real_distribution<float> dis(offset.x, offset.y);
 
-					ma_sound_start(&Globals.gun);
-					SpawnBullet(player.Position + dir * 0.5f, RandomOnHemisphere(dir, glm::normalize(dir + glm::vec2(dis(gen), dis(gen)))), player.Weapon, (Entity*)&player);
+					PlaySound(SoundEffect::Gun);
+					SpawnBullet(player.Position + dir * 0.5f, RandomOnHemisphere(dir, glm::normalize(dir + random.RangeVec2(offset.x, offset.y))), player.Weapon, player.Handle);
 				}
 
 				player.Weapons[(int)player.Weapon].Magazine--;
@@ -1084,15 +974,13 @@ namespace wc
 			}
 
 			//alt fire
-			if (ImGui::IsKeyDown(ImGuiKey_MouseRight) && player.CanShoot())
+			if (input.AltFire && player.CanShoot())
 			{
-				glm::vec2 dir = glm::normalize(glm::vec2(camera.Position) + m_Renderer.ScreenToWorld(Globals.window.GetCursorPos()) - player.Position);
-
 				player.ResetWeaponTimer(false);
 
 				if (player.Weapon == WeaponType::Revolver)
 				{
-					ma_sound_start(&Globals.gun);
+					PlaySound(SoundEffect::Gun);
 
 					player.Weapons[(int)player.Weapon].AltFireTimer = 1.2f;
 					player.Weapons[(int)player.Weapon].Timer = 0.f;
@@ -1104,15 +992,11 @@ namespace wc
 			{
 				if (player.Weapon == WeaponType::Revolver) 
 				{
-					std::random_device rd;
-					std::mt19937 gen(rd());
-					std::uniform_real_distribution<float> dis(-0.25f, 0.25f);
+					auto& random = GetRandom();
 
 					if (player.CanShoot())
 					{
-						glm::vec2 dir = glm::normalize(glm::vec2(camera.Position) + m_Renderer.ScreenToWorld(Globals.window.GetCursorPos()) - player.Position);
-
-						SpawnBullet(player.Position + dir * 0.75f, RandomOnHemisphere(dir, glm::normalize(dir + glm::vec2(dis(gen), dis(gen)))), player.Weapon, (Entity*)&player);
+						SpawnBullet(player.Position + dir * 0.75f, RandomOnHemisphere(dir, glm::normalize(dir + random.RangeVec2(-0.25f, 0.25f))), player.Weapon, player.Handle);
 						player.Weapons[(int)player.Weapon].Magazine--;
 						player.Weapons[(int)player.Weapon].Timer = 0.2f;
 					}
@@ -1120,32 +1004,40 @@ namespace wc
 			}
 
 
-			if (ImGui::IsKeyDown((ImGuiKey)Globals.settings.KeyMelee) && player.CanMelee()) 
+			if (input.Melee && player.CanMelee()) 
 			{
 				if (player.MeleeWeapon == WeaponType::Sword)
 				{
-					ma_sound_start(&Globals.swordSwing);
-					m_RotateSword = true;
+					PlaySound(SoundEffect::SwordSwing);
+					Events.SwordSwing = true;
 
-					for (uint32_t i = 0; i < Entities.size(); i++)
-					{
-						auto& entity = *Entities[i];
-						if (entity.Type == EntityType::RedCube || entity.Type == EntityType::Fly)
+					float range = WeaponStats[(int)player.MeleeWeapon].Range;
+
+					// Enemies in range are checked for a wall in between with one batched ray cast
+					std::vector<Entity*> targets;
+					std::vector<Ray> rays;
+					GetEntityGrid().QueryRadius(player.Position, range, [&](uint32_t i)
 						{
-							float dist = glm::distance(entity.Position, player.Position);
-							if (dist < WeaponStats[(int)player.MeleeWeapon].Range)
+							auto& entity = *m_GridEntities[i];
+							if ((entity.Type == EntityType::RedCube || entity.Type == EntityType::Fly) && glm::distance(entity.Position, player.Position) < range)
 							{
-								glm::vec2 direction = glm::normalize(entity.Position - player.Position);
+								targets.push_back(&entity);
+								rays.emplace_back(player.Position, glm::normalize(entity.Position - player.Position));
+							}
+						});
 
-								auto hitInfo = Intersect({ player.Position, direction }, Entities.size()); // We skip entity intersection
+					std::vector<HitInfo> hits(rays.size());
+					IntersectBatch(rays, hits, {}, 0); // We skip entity intersection
 
-								if ((hitInfo.Hit && dist <= hitInfo.t) || !hitInfo.Hit)
-								{
-									auto vel = glm::sign(direction.x) * 15.f * entity.Body->GetMass();
-									entity.Body->ApplyLinearImpulseToCenter(b2Vec2(vel, 0.f), true);
-									entity.DealDamage(WeaponStats[(int)player.MeleeWeapon].Damage);
-								}
-							}
+					for (uint32_t i = 0; i < targets.size(); i++)
+					{
+						auto& entity = *targets[i];
+						float dist = glm::distance(entity.Position, player.Position);
+						if ((hits[i].Hit && dist <= hits[i].t) || !hits[i].Hit)
+						{
+							auto vel = glm::sign(rays[i].Direction.x) * 15.f * entity.Body->GetMass();
+							entity.Body->ApplyLinearImpulseToCenter(b2Vec2(vel, 0.f), true);
+							entity.DealDamage(WeaponStats[(int)player.MeleeWeapon].Damage);
 						}
 					}
 				}
@@ -1154,18 +1046,21 @@ namespace wc
 			}
 		}
 
-		void Update()
+		// One frame of simulation: AI, fixed steps of physics and bullets and the timers
+		void Update(float deltaTime)
 		{
+			WC_PROFILE_SCOPE("Map::Update");
+
 			const int32_t velocityIterations = 8;
 			const int32_t positionIterations = 3;
 			const int32_t MAX_STEPS = 5;
 
-			AccumulatedTime += Globals.deltaTime;
+			AccumulatedTime += deltaTime;
 
 			const int32_t nSteps = (int32_t)glm::floor(AccumulatedTime / SimulationTime);
 			const int32_t nStepsClamped = glm::min(nSteps, MAX_STEPS);
 
-			UpdateAI();
+			UpdateAI(deltaTime);
 			if (nStepsClamped > 0)
 			{
 				AccumulatedTime -= nStepsClamped * SimulationTime;
@@ -1173,190 +1068,179 @@ namespace wc
 				for (int i = 0; i < nStepsClamped; i++)
 				{
 					FixedUpdate();
+					UpdateTileCollision();
+
+					WC_PROFILE_SCOPE("b2World::Step");
 					PhysicsWorld->Step(SimulationTime, velocityIterations, positionIterations);
 				}
 			}
 
 			float AccumulatedTimeRatio = AccumulatedTime / SimulationTime;
 
-			for (auto& entity : Entities)
-				entity->UpdatePosition(AccumulatedTimeRatio);
+			Entities.ForEachCharacter([&](Entity& entity) { entity.UpdatePosition(AccumulatedTimeRatio); });
+			m_EntityGridDirty = true;
 
-			if (player.DashCD > 0.f) player.DashCD -= Globals.deltaTime;
+			if (player.DashCD > 0.f) player.DashCD -= deltaTime;
 
 			for (uint32_t i = 0; i < magic_enum::enum_count<WeaponType>(); i++)
 			{
 				auto& weapon = player.Weapons[i];
-				if (weapon.Timer > 0.f) weapon.Timer -= Globals.deltaTime;
-				if (weapon.AltFireTimer > 0.f) weapon.AltFireTimer -= Globals.deltaTime;
-				if (weapon.ReloadTimer > 0.f) weapon.ReloadTimer -= Globals.deltaTime;
-			}
-		}
-
-		void UpdateGame()
-		{
-			Update();
-
-			LevelTime += Globals.deltaTime;
-			//m_TargetPosition = glm::clamp(m_TargetPosition, glm::vec2(8, 4), glm::vec2(Size) - glm::vec2(8, 4));
-
-			camera.Position += glm::vec3((m_TargetPosition - glm::vec2(camera.Position)) * 11.5f * Globals.deltaTime, 0.f);
-			camera.Rotation += (m_TargetRotation - camera.Rotation) * 11.5f * Globals.deltaTime;
-			if (camera.Zoom != m_TargetZoom)
-			{
-				camera.Zoom += (m_TargetZoom - camera.Zoom) * 11.5f * Globals.deltaTime;
-				camera.Update(m_Renderer.GetHalfSize());
+				if (weapon.Timer > 0.f) weapon.Timer -= deltaTime;
+				if (weapon.AltFireTimer > 0.f) weapon.AltFireTimer -= deltaTime;
+				if (weapon.ReloadTimer > 0.f) weapon.ReloadTimer -= deltaTime;
 			}
-			m_Renderer.ChromaSettings.Falloff += (m_TargetChromaFallOff - m_Renderer.ChromaSettings.Falloff) * 11.5f * Globals.deltaTime;
-
-			m_ParticleEmitter.OnUpdate();
 
-			if (!player.Alive()) Globals.gameState = GameState::DEATH;
-			if (EnemyCount == 0) Globals.gameState = GameState::WIN;
+			LevelTime += deltaTime;
 		}
 
-		void RenderGame()
+		// FNV-1a over the raw bits of everything the simulation carries from one frame to the next, replays compare it
+		// every frame to find where they diverge. Handles and Events are left out, they don't feed back
+		uint64_t HashState() const
 		{
-			m_RenderData.ViewProjection = glm::ortho(-0.5f, 0.5f, -0.5f, 0.5f, -1.f, 1.f);
-			m_RenderData.DrawQuad({ 0.f, 0.f, 0.f }, { 1.f, 1.f }, m_Renderer.BackgroundTexture);
-			m_RenderData.ViewProjection = camera.GetViewProjectionMatrix();
-						
-			for (uint32_t x = 0; x < Size.x; x++)
-				for (uint32_t y = 0; y < Size.y; y++)
+			uint64_t hash = 14695981039346656037ull;
+			auto add = [&](const auto& value)
 				{
-					TileID tileID = GetTile({ x,y, 0 });
-					if (tileID != 0) m_RenderData.DrawQuad({ x, y , 0.f }, { 1.f, 1.f }, 0, glm::vec4(0.27f, 0.94f, 0.98f, 1.f));
-				}
+					const uint8_t* bytes = (const uint8_t*)&value;
+					for (size_t i = 0; i < sizeof(value); i++)
+					{
+						hash ^= bytes[i];
+						hash *= 1099511628211ull;
+					}
+				};
+			auto addEntity = [&](const Entity& entity)
+				{
+					add(entity.Position);
+					add(entity.Health);
+					if (entity.Body)
+					{
+						add(entity.Body->GetPosition());
+						add(entity.Body->GetLinearVelocity());
+					}
+				};
 
-			for (int i = 0; i < Entities.size(); i++)
-			{
-				Entity& entity = *(Entity*)(Entities[i]);
+			add(AccumulatedTime);
+			add(LevelTime);
+			add(EnemyCount);
 
-				if (entity.Type == EntityType::Bullet)
-				{
-					Bullet& bullet = *(Bullet*)(Entities[i]);
-					m_RenderData.DrawCircle(glm::vec3(entity.Position, 0.f), entity.Size.x, 1.f, 0.05f, bullet.Color * 1.3f);
-				}
-				else
-				{
-					if (entity.Type != EntityType::Player)
-						m_RenderData.DrawString(std::format("HP: {}", entity.Health), font, entity.Position + glm::vec2(-0.5f, 1.f), glm::vec4(1.f, 0, 0, 1.f));
+			addEntity(player);
+			add(player.Weapon);
+			add(player.DashCD);
+			add(player.JumpForce);
+			add(player.DownContacts);
+			for (const auto& weapon : player.Weapons) add(weapon);
 
-					m_RenderData.DrawQuad(glm::vec3(entity.Position, 0.f), entity.Size * 2.f, 0, entity.Type == EntityType::RedCube || entity.Type == EntityType::Fly ? glm::vec4(1.f, 0, 0, 1.f) : glm::vec4(0.27f, 0.94f, 0.98f, 1.f));
-				}
+			for (const auto& entity : Entities.RedCubes)
+			{
+				addEntity(entity);
+				add(entity.AttackTimer);
 			}
-
-			if (m_RotateSword)
+			for (const auto& entity : Entities.Flies)
 			{
-				m_SwordRotation += (2.f * glm::pi<float>() - m_SwordRotation) * 11.5f * Globals.deltaTime;
-
-				if (m_SwordRotation >= 2.f * glm::pi<float>() - 0.1f)
-				{
-					m_SwordRotation = 0.f;
-					m_RotateSword = false;
-				}
-				glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(player.Position, 0.f)) *
-					glm::rotate(glm::mat4(1.f), m_SwordRotation, { 0.f, 0.f, 1.f }) * glm::scale(glm::mat4(1.f),
-						glm::vec3{ 0.14f, 1.f, 0.5f } * 6.f);
-
-				m_RenderData.DrawQuad(transform, SwordTexture);
+				addEntity(entity);
+				add(entity.AttackTimer);
 			}
-			else
+			for (const auto& bullet : Entities.Bullets)
 			{
-				auto& weapon = WeaponStats[(int)player.Weapon];
-
-				glm::vec2 dir = glm::normalize(glm::vec2(camera.Position) + m_Renderer.ScreenToWorld(Globals.window.GetCursorPos()) - player.Position);
-				glm::vec2 offset = weapon.RenderOffset;
-				float angle = atan2(dir.y, dir.x);
-				if (dir.x < 0.f)
-				{
-					angle = glm::pi<float>() - angle;
-					offset.x *= -1.f;
-				}
-				glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(player.Position, 0.f)) *
-					glm::rotate(glm::mat4(1.f), angle, { 0.f, 0.f, dir.x < 0.f ? -1.f : 1.f }) *
-					glm::translate(glm::mat4(1.f), glm::vec3(offset, 0.f)) * glm::scale(glm::mat4(1.f),
-						{ (dir.x < 0.f ? -1.f : 1.f) * weapon.RenderSize.x, weapon.RenderSize.y, 1.f });
-
-				m_RenderData.DrawQuad(transform, weapon.TextureID);
+				addEntity(bullet);
+				add(bullet.Direction);
+				add(bullet.Bounces);
+				add(bullet.DistanceTraveled);
 			}
-
-			glm::vec2 dir = glm::normalize(glm::vec2(camera.Position) + m_Renderer.ScreenToWorld(Globals.window.GetCursorPos()) - player.Position);
-			glm::vec2 shootPos = player.Position + dir * 0.35f;
-
-			m_ParticleEmitter.OnRender(m_RenderData);
-
-			m_Renderer.Flush(m_RenderData);
-			m_RenderData.Reset();
+			return hash;
 		}
 
-		uint32_t Get1DSize() { return m_Size; }
-		TileID* GetData() { return m_Data; }
+		// Tiles are only written through SetTile and Load so m_Occupancy stays in sync
+		const TileStorage& GetTiles() const { return m_Tiles; }
+		const TileOccupancy& GetOccupancy() const { return m_Occupancy; }
+
+		// Chunks changed since the last call, for caches of the tiles outside of the simulation like MapView's meshes
+		template<typename Func>
+		void ForEachRenderDirtyChunk(Func&& func) { m_Tiles.ForEachDirty(CHUNK_DIRTY_RENDER, func); }
 
 	public:
 		glm::uvec3 Size = glm::uvec3(1);
 
-		std::vector<Entity*> Entities;
+		EntityRegistry Entities;
 
 		Player player;
 
 		b2World* PhysicsWorld = nullptr;
+		b2Body* TerrainBody = nullptr; // Static body holding all tile collision
 
 		uint32_t EnemyCount = 0;
+		static constexpr float SimulationTime = 1.f / 60.f; // Length of one fixed step
 
-		OrthographicCamera camera;
+		MapEvents Events; // Since the last Clear, the consumer clears it
 
 		float DragStrength = 2.f;
 		float AirSpeedFactor = 0.7f;
-		uint32_t SwordTexture = 0;
-		Font font;
 
-		bool m_RotateSword = false;
-		float m_SwordRotation = 0.f;
 		float AccumulatedTime = 0.f;
 
 		float LevelTime = 0.f;
 	private:
-		TileID* m_Data = nullptr;
-		uint32_t m_Size = 1;
+		TileStorage m_Tiles;
+		TileOccupancy m_Occupancy; // Solidity bits of layer 0 for ray casts, follows every change to m_Tiles
+		std::vector<std::vector<b2Fixture*>> m_ChunkFixtures; // Terrain fixtures owned by each chunk
+
+		RayBatch m_RayBatch; // Scratch for IntersectBatch
+		std::vector<float> m_RayDistances;
+		std::vector<glm::vec2> m_RayNormals;
 
-		glm::vec2 m_TargetPosition;
-		float m_TargetRotation = 0.f;
-		float m_TargetZoom = 1.f;
-		float m_TargetChromaFallOff = 10.f;
+		std::vector<EntityHandle> m_DestroyQueue;
 
+		EntityGrid m_EntityGrid;
+		std::vector<Entity*> m_GridEntities; // Entity of every grid index, rebuilt with the grid
+		std::vector<Bullet*> m_SolidBullets; // Scratch for SimulateBullets
+		glm::uvec2 m_EntityGridSize = glm::uvec2(0); // Map size the grid was initialized for
+		bool m_EntityGridDirty = true;
 
-		const float SimulationTime = 1.f / 60.f;
+		static constexpr uint32_t BulletPoolCapacity = 1024; // Bullets alive at once before the pool has to grow
 
 	private:
+		// Only the entities in the cells along the ray up to the closest hit so far are tested
+		void IntersectEntities(const Ray& ray, uint32_t entityTypes, float& t, HitInfo& hitInfo)
+		{
+			if (entityTypes == 0) return;
+
+			GetEntityGrid().QueryRay(ray, t, [&](uint32_t i)
+				{
+					auto& entity = *m_GridEntities[i];
+					if (!(entityTypes & EntityTypeBit(entity.Type))) return;
+
+					auto oHitInfo = aabbIntersection(ray, -entity.Size + entity.Position, entity.Size + entity.Position);
+					if (oHitInfo.Hit && oHitInfo.t < t)
+					{
+						hitInfo.Hit = true;
+						t = oHitInfo.t;
+						hitInfo.Entity = &entity;
+						hitInfo.N = oHitInfo.N;
+						hitInfo.Point = oHitInfo.Point;
+					}
+				});
+		}
 
 		std::vector<std::pair<TileID, uint16_t>> Compress()
 		{
 			std::vector<std::pair<TileID, uint16_t>> compressed;
-			TileID pBlockID = m_Data[0];
+			TileID pBlockID = GetTile({ 0, 0, 0 });
 			uint16_t count = 0;
 
-			for (uint32_t i = 0; i < Size.x * Size.y * Size.z; i++) // @TODO: optimize
-			{
-				TileID block = m_Data[i];
-				if (block == pBlockID) count++;
-				else
-				{
-					compressed.emplace_back(pBlockID, count);
-					pBlockID = m_Data[i];
-					count = 1;
-				}
-			}
+			for (uint32_t z = 0; z < Size.z; z++)
+				for (uint32_t y = 0; y < Size.y; y++)
+					for (uint32_t x = 0; x < Size.x; x++)
+					{
+						TileID block = GetTile({ x, y, z });
+						if (block == pBlockID) count++;
+						else
+						{
+							compressed.emplace_back(pBlockID, count);
+							pBlockID = block;
+							count = 1;
+						}
+					}
 			compressed.emplace_back(pBlockID, count);
 			return compressed;
 		}
-
-		void Decompress(const std::vector<std::pair<TileID, uint16_t>>& tiles)
-		{
-			uint16_t counter = 0;
-			for (auto& tile : tiles)
-				for (uint16_t i = 0; i < tile.second; i++)
-					m_Data[counter++] = tile.first;
-		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <format>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../Rendering/Culling.h"
+#include "Map.h"
+
+namespace wc
+{
+	// What MapView draws on top of the Map that the simulation does not know about
+	struct MapDrawParams
+	{
+		glm::vec2 Aim = { 1.f, 0.f }; // From the player towards the cursor, the weapon points along it
+		bool SwordSwing = false;
+		float SwordRotation = 0.f;
+		uint32_t SwordTexture = 0;
+		uint32_t TileQuadCount = 0; // Quads in all chunk meshes, the ones in chunks outside the view count as culled
+	};
+
+	// The tiles, the player, enemies with their HP labels, bullets and the weapon of a Map, culled against drawList.View.
+	// DrawList needs RenderData's View, Culling, DrawQuad, DrawCircle and DrawString, so MapView builds straight into
+	// RenderData and the benchmarks into host memory. drawChunk(chunk) draws the mesh of a chunk under the view and
+	// returns how many quads it has
+	template<typename DrawList, typename FontType, typename DrawChunk>
+	void BuildMapDrawList(const Map& map, const MapDrawParams& params, const FontType& font, DrawList& drawList, DrawChunk&& drawChunk)
+	{
+		const CullRect& view = drawList.View;
+
+		if (map.IsLoaded())
+		{
+			// Tile x covers [x - 0.5, x + 0.5], so only the chunks under the view rect can have visible tiles
+			glm::ivec2 minTile = glm::max(glm::ivec2(glm::floor(view.Min + 0.5f)), glm::ivec2(0));
+			glm::ivec2 maxTile = glm::min(glm::ivec2(glm::floor(view.Max + 0.5f)), glm::ivec2(map.Size) - 1);
+
+			uint32_t submittedQuads = 0;
+			if (minTile.x <= maxTile.x && minTile.y <= maxTile.y)
+			{
+				glm::uvec2 minChunk = glm::uvec2(minTile) >> ChunkShift;
+				glm::uvec2 maxChunk = glm::uvec2(maxTile) >> ChunkShift;
+				for (uint32_t y = minChunk.y; y <= maxChunk.y; y++)
+					for (uint32_t x = minChunk.x; x <= maxChunk.x; x++)
+						submittedQuads += drawChunk(map.GetTiles().GetChunkIndex({ x * ChunkSize, y * ChunkSize, 0 }));
+			}
+
+			drawList.Culling.Tiles.Submitted += submittedQuads;
+			drawList.Culling.Tiles.Culled += params.TileQuadCount - submittedQuads;
+		}
+
+		const Player& player = map.player;
+		if (drawList.Culling.Entities.Count(view.OverlapsCentered(player.Position, player.Size)))
+			drawList.DrawQuad(glm::vec3(player.Position, 0.f), player.Size * 2.f, 0, glm::vec4(0.27f, 0.94f, 0.98f, 1.f));
+
+		auto drawEnemy = [&](const Entity& entity)
+			{
+				// The label starts half a tile left of the entity, one tile above it and is about 4 tiles wide
+				glm::vec2 labelMin = entity.Position + glm::vec2(-0.5f, 0.7f);
+				if (drawList.Culling.Text.Count(view.Overlaps(labelMin, labelMin + glm::vec2(4.f, 1.f))))
+					drawList.DrawString(std::format("HP: {}", entity.Health), font, entity.Position + glm::vec2(-0.5f, 1.f), glm::vec4(1.f, 0, 0, 1.f));
+
+				if (drawList.Culling.Entities.Count(view.OverlapsCentered(entity.Position, entity.Size)))
+					drawList.DrawQuad(glm::vec3(entity.Position, 0.f), entity.Size * 2.f, 0, glm::vec4(1.f, 0, 0, 1.f));
+			};
+		for (const auto& entity : map.Entities.RedCubes) drawEnemy(entity);
+		for (const auto& entity : map.Entities.Flies) drawEnemy(entity);
+
+		for (const auto& bullet : map.Entities.Bullets)
+		{
+			glm::vec2 position = glm::mix(bullet.PreviousPosition, bullet.Position, map.AccumulatedTime / Map::SimulationTime);
+			if (!drawList.Culling.Entities.Count(view.OverlapsCentered(position, glm::vec2(bullet.Size.x)))) continue;
+
+			drawList.DrawCircle(glm::vec3(position, 0.f), bullet.Size.x, 1.f, 0.05f, bullet.Color * 1.3f);
+		}
+
+		if (params.SwordSwing)
+		{
+			glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(player.Position, 0.f)) *
+				glm::rotate(glm::mat4(1.f), params.SwordRotation, { 0.f, 0.f, 1.f }) * glm::scale(glm::mat4(1.f),
+					glm::vec3{ 0.14f, 1.f, 0.5f } * 6.f);
+
+			drawList.DrawQuad(transform, params.SwordTexture);
+		}
+		else
+		{
+			auto& weapon = WeaponStats[(int)player.Weapon];
+
+			glm::vec2 dir = params.Aim;
+			glm::vec2 offset = weapon.RenderOffset;
+			float angle = atan2(dir.y, dir.x);
+			if (dir.x < 0.f)
+			{
+				angle = glm::pi<float>() - angle;
+				offset.x *= -1.f;
+			}
+			glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(player.Position, 0.f)) *
+				glm::rotate(glm::mat4(1.f), angle, { 0.f, 0.f, dir.x < 0.f ? -1.f : 1.f }) *
+				glm::translate(glm::mat4(1.f), glm::vec3(offset, 0.f)) * glm::scale(glm::mat4(1.f),
+					{ (dir.x < 0.f ? -1.f : 1.f) * weapon.RenderSize.x, weapon.RenderSize.y, 1.f });
+
+			drawList.DrawQuad(transform, weapon.TextureID);
+		}
+	}
+}
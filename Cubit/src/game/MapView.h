@@ -0,0 +1,211 @@
+#pragma once
+
+#include <wc/Math/Camera.h>
+
+#include <imgui/imgui.h>
+
+#include "../Globals.h"
+#include "../Profiler.h"
+#include "../Rendering/Renderer2D.h"
+#include "../Rendering/TileMesh.h"
+#include "GPUParticleSystem.h"
+#include "Map.h"
+#include "MapDrawList.h"
+#include "ParticleSystem.h"
+
+namespace wc
+{
+	RenderData m_RenderData;
+	Renderer2D m_Renderer;
+
+	// Define WC_GPU_PARTICLES to simulate the particles in a compute shader, both have the same interface
+#ifdef WC_GPU_PARTICLES
+	GPUParticleSystem m_ParticleEmitter;
+#else
+	ParticleSystem m_ParticleEmitter;
+#endif
+
+	// Everything of a Map that is only seen or heard: input sampling, the camera following the player, the tile
+	// meshes, particles, sounds and the sword animation. The Map is never changed besides draining its Events,
+	// so headless runs and replays simulate exactly what the game does
+	class MapView
+	{
+	public:
+		OrthographicCamera Camera;
+		Font font;
+		uint32_t SwordTexture = 0;
+
+		// Call after every Map::LoadFull
+		void OnLoad(const Map& map)
+		{
+			Camera.Position = glm::vec3(map.player.Position, 0.f);
+			m_TargetPosition = map.player.Position;
+
+			//stopping sword animation
+			m_RotateSword = false;
+			m_SwordRotation = 0.f;
+
+			m_ParticleEmitter.Reset();
+		}
+
+		// Samples the keyboard and mouse, the aim goes from the player towards the cursor. GameInstance applies it in the
+		// same frame's update, so recordings see input and delta time together
+		PlayerInput GatherInput(const Map& map) const
+		{
+			PlayerInput input;
+			if (ImGui::IsKeyDown((ImGuiKey)Globals.settings.KeyLeft)) input.MoveDir = -1.f;
+			else if (ImGui::IsKeyDown((ImGuiKey)Globals.settings.KeyRight)) input.MoveDir = 1.f;
+
+			input.Aim = glm::normalize(GetCursorWorldPosition() - map.player.Position);
+
+			input.Jump = ImGui::IsKeyPressed((ImGuiKey)Globals.settings.KeyJump);
+			input.Dash = Key::GetKey(Key::LeftShift) == GLFW_PRESS;
+			input.Fire = ImGui::IsMouseDown(ImGuiMouseButton_Left);
+			input.AltFire = Mouse::GetMouse(Mouse::RIGHT) != GLFW_RELEASE;
+			input.Melee = ImGui::IsKeyDown((ImGuiKey)Globals.settings.KeyMelee);
+			input.Reload = ImGui::IsKeyPressed(ImGuiKey_R);
+			input.SwitchWeapon = ImGui::IsKeyReleased((ImGuiKey)Globals.settings.KeyFastSwich);
+			input.SelectPrimary = ImGui::IsKeyPressed((ImGuiKey)Globals.settings.KeyMainWeapon);
+			input.SelectSecondary = ImGui::IsKeyPressed((ImGuiKey)Globals.settings.KeySecondaryWeapon);
+			return input;
+		}
+
+		// After Map::Update, input is the one applied this frame or nullptr. Plays and emits the map's events,
+		// then the camera and chroma follow the player and the particles and the sword animation advance
+		void Update(Map& map, const PlayerInput* input, float deltaTime)
+		{
+			WC_PROFILE_SCOPE("MapView::Update");
+
+			MapEvents& events = map.Events;
+			for (SoundEffect sound : events.Sounds) PlaySound(sound);
+			for (const auto& burst : events.Particles) m_ParticleEmitter.Emit(burst.Props, burst.Amount);
+			if (events.CameraShake > 0.f) Camera.Shake(events.CameraShake);
+			if (events.SwordSwing) m_RotateSword = true;
+			events.Clear();
+
+			if (input)
+			{
+				bool zoom = WeaponStats[(int)map.player.Weapon].CanZoom && input->AltFire;
+
+				m_TargetRotation = 0.f;
+				if (zoom)
+				{
+					m_TargetPosition = map.player.Position + input->Aim * 3.f;
+					m_TargetZoom = 0.6f;
+				}
+				else
+				{
+					m_TargetPosition = map.player.Position;
+					m_TargetZoom = 1.f;
+				}
+			}
+
+			Camera.Position += glm::vec3((m_TargetPosition - glm::vec2(Camera.Position)) * 11.5f * deltaTime, 0.f);
+			Camera.Rotation += (m_TargetRotation - Camera.Rotation) * 11.5f * deltaTime;
+			if (Camera.Zoom != m_TargetZoom)
+			{
+				Camera.Zoom += (m_TargetZoom - Camera.Zoom) * 11.5f * deltaTime;
+				Camera.Update(m_Renderer.GetHalfSize());
+			}
+			m_Renderer.ChromaSettings.Falloff += (m_TargetChromaFallOff - m_Renderer.ChromaSettings.Falloff) * 11.5f * deltaTime;
+
+			m_ParticleEmitter.OnUpdate(deltaTime);
+
+			if (m_RotateSword)
+			{
+				m_SwordRotation += (2.f * glm::pi<float>() - m_SwordRotation) * 11.5f * deltaTime;
+
+				if (m_SwordRotation >= 2.f * glm::pi<float>() - 0.1f)
+				{
+					m_SwordRotation = 0.f;
+					m_RotateSword = false;
+				}
+			}
+		}
+
+		void Render(Map& map)
+		{
+			WC_PROFILE_SCOPE("MapView::Render");
+
+			m_RenderData.ViewProjection = glm::ortho(-0.5f, 0.5f, -0.5f, 0.5f, -1.f, 1.f);
+			m_RenderData.DrawQuad({ 0.f, 0.f, 0.f }, { 1.f, 1.f }, m_Renderer.BackgroundTexture);
+			m_RenderData.ViewProjection = Camera.GetViewProjectionMatrix();
+			m_RenderData.View = m_Renderer.GetViewRect();
+
+			UpdateTileMeshes(map);
+
+			MapDrawParams params;
+			params.Aim = glm::normalize(GetCursorWorldPosition() - map.player.Position);
+			params.SwordSwing = m_RotateSword;
+			params.SwordRotation = m_SwordRotation;
+			params.SwordTexture = SwordTexture;
+			params.TileQuadCount = m_TileMeshes.GetQuadCount();
+			BuildMapDrawList(map, params, font, m_RenderData, [&](uint32_t chunk)
+				{
+					const auto& mesh = m_TileMeshes.Get(chunk);
+					if (mesh.QuadCount) m_RenderData.DrawTileMesh(mesh.Address, mesh.QuadCount);
+					return mesh.QuadCount;
+				});
+
+			m_ParticleEmitter.OnRender(m_RenderData);
+
+			m_Renderer.Flush(m_RenderData);
+			m_RenderData.Reset();
+		}
+
+		// GPU buffers can only be destroyed once the device is idle
+		void Destroy() { m_TileMeshes.Destroy(); }
+	private:
+		glm::vec2 GetCursorWorldPosition() const { return glm::vec2(Camera.Position) + m_Renderer.ScreenToWorld(Globals.window.GetCursorPos()); }
+
+		static void PlaySound(SoundEffect sound)
+		{
+			switch (sound)
+			{
+			case SoundEffect::Gun: ma_sound_start(&Globals.gun); break;
+			case SoundEffect::Shotgun: ma_sound_start(&Globals.shotgun); break;
+			case SoundEffect::SwordSwing: ma_sound_start(&Globals.swordSwing); break;
+			case SoundEffect::DamageEnemy: ma_sound_start(&Globals.damageEnemy); break;
+			case SoundEffect::Dash: ma_engine_play_sound(&Globals.sfx_engine, "assets/sound/sfx/dash.wav", NULL); break;
+			}
+		}
+
+		// Re-emits the quads of the chunks changed since the last frame, all of them after the map was reloaded
+		void UpdateTileMeshes(Map& map)
+		{
+			if (m_TileMeshes.GetChunkCount() != map.GetTiles().GetChunkTotal()) m_TileMeshes.Resize(map.GetTiles().GetChunkTotal());
+
+			m_TileMeshes.Update();
+			map.ForEachRenderDirtyChunk([&](uint32_t chunk)
+				{
+					m_TileMeshes.BeginChunk();
+
+					const TileStorage& tiles = map.GetTiles();
+					if (!tiles.IsChunkEmpty(chunk) && tiles.GetChunkCoords(chunk).z == 0)
+					{
+						glm::uvec2 min, max;
+						tiles.GetChunkBounds(chunk, min, max);
+						for (uint32_t x = min.x; x < max.x; x++)
+							for (uint32_t y = min.y; y < max.y; y++)
+							{
+								TileID tileID = map.GetTile({ x,y, 0 });
+								if (tileID != 0) m_TileMeshes.AddQuad({ x, y }, { 1.f, 1.f }, 0, glm::vec4(0.27f, 0.94f, 0.98f, 1.f));
+							}
+					}
+
+					m_TileMeshes.EndChunk(chunk);
+				});
+			m_TileMeshes.Submit();
+		}
+
+		TileMeshCache m_TileMeshes;
+
+		glm::vec2 m_TargetPosition = glm::vec2(0.f);
+		float m_TargetRotation = 0.f;
+		float m_TargetZoom = 1.f;
+		float m_TargetChromaFallOff = 10.f;
+
+		bool m_RotateSword = false;
+		float m_SwordRotation = 0.f;
+	};
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <bit>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../Rendering/Quad.h"
+
+namespace wc
+{
+	// Particles stored as separate arrays, the first Count entries are alive
+	struct ParticlePool
+	{
+		std::vector<glm::vec2> Positions;
+		std::vector<glm::vec2> Velocities;
+		std::vector<float> Rotations;
+		std::vector<glm::vec4> ColorsBegin, ColorsEnd;
+		std::vector<float> SizesBegin, SizesEnd;
+		std::vector<float> LifeTimes;
+		std::vector<float> LifeRemaining;
+
+		uint32_t Count = 0;
+
+		uint32_t GetCapacity() const { return (uint32_t)Positions.size(); }
+
+		void Resize(uint32_t capacity)
+		{
+			Positions.resize(capacity);
+			Velocities.resize(capacity);
+			Rotations.resize(capacity);
+			ColorsBegin.resize(capacity);
+			ColorsEnd.resize(capacity);
+			SizesBegin.resize(capacity);
+			SizesEnd.resize(capacity);
+			LifeTimes.resize(capacity);
+			LifeRemaining.resize(capacity);
+			Count = glm::min(Count, capacity);
+		}
+
+		// Moves the last alive particle into index so the alive range stays dense
+		void Remove(uint32_t index)
+		{
+			uint32_t last = --Count;
+			if (index == last)
+				return;
+
+			Positions[index] = Positions[last];
+			Velocities[index] = Velocities[last];
+			Rotations[index] = Rotations[last];
+			ColorsBegin[index] = ColorsBegin[last];
+			ColorsEnd[index] = ColorsEnd[last];
+			SizesBegin[index] = SizesBegin[last];
+			SizesEnd[index] = SizesEnd[last];
+			LifeTimes[index] = LifeTimes[last];
+			LifeRemaining[index] = LifeRemaining[last];
+		}
+
+		// Swap-removes every particle whose lifetime ran out
+		void RemoveDead()
+		{
+			for (uint32_t i = 0; i < Count;)
+			{
+				if (LifeRemaining[i] <= 0.f)
+					Remove(i); // The swapped in particle is checked on the next iteration
+				else
+					i++;
+			}
+		}
+	};
+
+	constexpr float ParticleRotationSpeed = 0.01f; // Radians per second
+
+	// Advances lifetime, position and rotation of every alive particle and removes the dead ones
+	inline void IntegrateParticlesScalar(ParticlePool& pool, float dt)
+	{
+		for (uint32_t i = 0; i < pool.Count; i++)
+		{
+			pool.LifeRemaining[i] -= dt;
+			pool.Positions[i] += pool.Velocities[i] * dt;
+			pool.Rotations[i] += ParticleRotationSpeed * dt;
+		}
+		pool.RemoveDead();
+	}
+
+	// Writes a quad for every particle overlapping [viewMin, viewMax] and returns how many were written.
+	// quads needs room for pool.Count - first entries
+	inline uint32_t BuildParticleQuadsScalar(const ParticlePool& pool, glm::vec2 viewMin, glm::vec2 viewMax, QuadDesc* quads, uint32_t first = 0)
+	{
+		uint32_t visible = 0;
+		for (uint32_t i = first; i < pool.Count; i++)
+		{
+			// Fade away particles
+			float life = pool.LifeRemaining[i] / pool.LifeTimes[i];
+			float size = pool.SizesEnd[i] + (pool.SizesBegin[i] - pool.SizesEnd[i]) * life;
+
+			// Half diagonal so any rotation stays inside the box
+			glm::vec2 position = pool.Positions[i];
+			glm::vec2 extent = glm::vec2(size * 0.71f);
+			if (position.x + extent.x < viewMin.x || position.x - extent.x > viewMax.x || position.y + extent.y < viewMin.y || position.y - extent.y > viewMax.y)
+				continue;
+
+			auto& quad = quads[visible++];
+			quad.Position = glm::vec3(position, 0.f);
+			quad.Rotation = pool.Rotations[i];
+			quad.Size = glm::vec2(size);
+			quad.TextureID = 0;
+			quad.Color = pool.ColorsEnd[i] + (pool.ColorsBegin[i] - pool.ColorsEnd[i]) * life;
+		}
+		return visible;
+	}
+
+	namespace ParticleSIMD
+	{
+		// dst[i] += src[i] * scale for count floats, 8 wide with AVX and 4 wide with SSE
+		inline void MulAdd(float* dst, const float* src, float scale, uint32_t count)
+		{
+			uint32_t i = 0;
+#if defined(__AVX__)
+			const __m256 scale8 = _mm256_set1_ps(scale);
+			for (; i + 8 <= count; i += 8)
+				_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), scale8)));
+#endif
+#ifdef WC_QUAD_SSE
+			const __m128 scale4 = _mm_set1_ps(scale);
+			for (; i + 4 <= count; i += 4)
+				_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), scale4)));
+#endif
+			for (; i < count; i++)
+				dst[i] += src[i] * scale;
+		}
+
+		// dst[i] += value for count floats
+		inline void Add(float* dst, float value, uint32_t count)
+		{
+			uint32_t i = 0;
+#if defined(__AVX__)
+			const __m256 value8 = _mm256_set1_ps(value);
+			for (; i + 8 <= count; i += 8)
+				_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), value8));
+#endif
+#ifdef WC_QUAD_SSE
+			const __m128 value4 = _mm_set1_ps(value);
+			for (; i + 4 <= count; i += 4)
+				_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), value4));
+#endif
+			for (; i < count; i++)
+				dst[i] += value;
+		}
+
+		// Index of the first particle at or after start whose lifetime ran out, or count if there is none
+		inline uint32_t FindDead(const float* lifeRemaining, uint32_t start, uint32_t count)
+		{
+			uint32_t i = start;
+#ifdef WC_QUAD_SSE
+			const __m128 zero = _mm_setzero_ps();
+			for (; i + 4 <= count; i += 4)
+			{
+				int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(lifeRemaining + i), zero));
+				if (mask)
+					return i + std::countr_zero((uint32_t)mask);
+			}
+#endif
+			for (; i < count; i++)
+				if (lifeRemaining[i] <= 0.f)
+					return i;
+			return count;
+		}
+	}
+
+	// Same result as IntegrateParticlesScalar. Positions and velocities are interleaved vec2 arrays,
+	// so they are integrated as one flat float array of twice the length
+	inline void IntegrateParticles(ParticlePool& pool, float dt)
+	{
+		uint32_t count = pool.Count;
+		ParticleSIMD::Add(pool.LifeRemaining.data(), -dt, count);
+		ParticleSIMD::MulAdd(&pool.Positions.data()->x, &pool.Velocities.data()->x, dt, count * 2);
+		ParticleSIMD::Add(pool.Rotations.data(), ParticleRotationSpeed * dt, count);
+
+		// Dead particles are rare compared to alive ones, skip over the alive ones 4 at a time
+		for (uint32_t i = ParticleSIMD::FindDead(pool.LifeRemaining.data(), 0, pool.Count); i < pool.Count; i = ParticleSIMD::FindDead(pool.LifeRemaining.data(), i, pool.Count))
+			pool.Remove(i); // The swapped in particle is checked by the next search
+	}
+
+	// Same result as BuildParticleQuadsScalar, 4 particles at a time with SSE.
+	// Every group stores all 4 quads and only advances the output past the visible ones
+	inline uint32_t BuildParticleQuads(const ParticlePool& pool, glm::vec2 viewMin, glm::vec2 viewMax, QuadDesc* quads)
+	{
+		uint32_t i = 0;
+		uint32_t visible = 0;
+#ifdef WC_QUAD_SSE
+		const __m128 minX = _mm_set1_ps(viewMin.x), minY = _mm_set1_ps(viewMin.y);
+		const __m128 maxX = _mm_set1_ps(viewMax.x), maxY = _mm_set1_ps(viewMax.y);
+		const __m128 halfDiagonal = _mm_set1_ps(0.71f);
+
+		for (; i + 4 <= pool.Count; i += 4)
+		{
+			__m128 life = _mm_div_ps(_mm_loadu_ps(&pool.LifeRemaining[i]), _mm_loadu_ps(&pool.LifeTimes[i]));
+			__m128 sizeEnd = _mm_loadu_ps(&pool.SizesEnd[i]);
+			__m128 size = _mm_add_ps(sizeEnd, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pool.SizesBegin[i]), sizeEnd), life));
+
+			__m128 p01 = _mm_loadu_ps(&pool.Positions[i].x), p23 = _mm_loadu_ps(&pool.Positions[i + 2].x);
+			__m128 x = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 y = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1));
+
+			__m128 extent = _mm_mul_ps(size, halfDiagonal);
+			__m128 inside = _mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(x, extent), minX), _mm_cmple_ps(_mm_sub_ps(x, extent), maxX)),
+				_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(y, extent), minY), _mm_cmple_ps(_mm_sub_ps(y, extent), maxY)));
+			int mask = _mm_movemask_ps(inside);
+			if (!mask)
+				continue;
+
+			// One row per quad: [Position, Rotation] and [Size, TextureID, _pad]
+			__m128 z = _mm_setzero_ps();
+			__m128 rotation = _mm_loadu_ps(&pool.Rotations[i]);
+			_MM_TRANSPOSE4_PS(x, y, z, rotation);
+			__m128 sizes01 = _mm_unpacklo_ps(size, size);
+			__m128 sizes23 = _mm_unpackhi_ps(size, size);
+			__m128 zero = _mm_setzero_ps();
+			__m128 rows[4][2] = {
+				{ x, _mm_movelh_ps(sizes01, zero) },
+				{ y, _mm_movehl_ps(zero, sizes01) },
+				{ z, _mm_movelh_ps(sizes23, zero) },
+				{ rotation, _mm_movehl_ps(zero, sizes23) },
+			};
+
+			float lifes[4];
+			_mm_storeu_ps(lifes, life);
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				__m128 colorEnd = _mm_loadu_ps(&pool.ColorsEnd[i + j].x);
+				__m128 color = _mm_add_ps(colorEnd, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pool.ColorsBegin[i + j].x), colorEnd), _mm_set1_ps(lifes[j])));
+
+				float* dst = &quads[visible].Position.x;
+				_mm_storeu_ps(dst, rows[j][0]);
+				_mm_storeu_ps(dst + 4, rows[j][1]);
+				_mm_storeu_ps(dst + 8, color);
+				visible += (mask >> j) & 1;
+			}
+		}
+#endif
+		return visible + BuildParticleQuadsScalar(pool, viewMin, viewMax, quads + visible, i);
+	}
+}
\ No newline at end of file
@@ -5,21 +5,14 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/compatibility.hpp>
 
+#include <algorithm>
 #include <vector>
-#include <random>
 
-#include "../Globals.h"
-#include "../Rendering/RenderData.h"
+#include "../Random.h"
+#include "ParticlePool.h"
 
 namespace wc
 {
-	inline float RandomValue()
-	{
-		static std::uniform_real_distribution<float> distribution(0.f, 1.f);
-		static std::mt19937 generator;
-		return distribution(generator);
-	}
-
 	struct ParticleProps
 	{
 		glm::vec2 Position;
@@ -29,99 +22,85 @@ namespace wc
 		float LifeTime = 1.f;
 	};
 
+	// Particles are only seen, so they draw from their own random stream and never shift the gameplay one
 	struct ParticleSystem
 	{
-		void Init()
+		// capacity is allocated up front, the pool doubles when it runs out up to maxCapacity
+		void Init(uint32_t capacity = 1'000, uint32_t maxCapacity = 100'000)
 		{
-			m_ParticlePool.resize(1000);
+			m_MaxCapacity = glm::max(capacity, maxCapacity);
+			m_Pool.Resize(capacity);
 		}
 
-		void OnUpdate()
+		void OnUpdate(float deltaTime)
 		{
-			for (auto& particle : m_ParticlePool)
-			{
-				if (!particle.Active)
-					continue;
-
-				if (particle.LifeRemaining <= 0.0f)
-				{
-					particle.Active = false;
-					continue;
-				}
-
-				particle.LifeRemaining -= Globals.deltaTime;
-				particle.Position += particle.Velocity * (float)Globals.deltaTime;
-				particle.Rotation += 0.01f * Globals.deltaTime;
-			}
+			IntegrateParticles(m_Pool, deltaTime);
 		}
-		void OnRender(RenderData& renderData)
-		{
-			for (auto& particle : m_ParticlePool)
-			{
-				if (!particle.Active)
-					continue;
 
-				// Fade away particles
-				float life = particle.LifeRemaining / particle.LifeTime;
-				glm::vec4 color = glm::lerp(particle.ColorEnd, particle.ColorBegin, life);
-				//color.a = color.a * life;
-
-				float size = glm::lerp(particle.SizeEnd, particle.SizeBegin, life);
+		// Takes RenderData or anything else with its View, Culling and DrawQuads
+		template<typename DrawList>
+		void OnRender(DrawList& renderData)
+		{
+			m_Quads.resize(m_Pool.Count);
+			uint32_t visible = BuildParticleQuads(m_Pool, renderData.View.Min, renderData.View.Max, m_Quads.data());
 
-				// Render
-				glm::mat4 transform = glm::translate(glm::mat4(1.f), { particle.Position.x, particle.Position.y, 0.0f })
-					* glm::rotate(glm::mat4(1.f), particle.Rotation, { 0.f, 0.f, 1.f })
-					* glm::scale(glm::mat4(1.f), { size, size, 1.0f });
-				renderData.DrawQuad(transform, 0, color);
-			}
+			renderData.Culling.Particles.Submitted += visible;
+			renderData.Culling.Particles.Culled += m_Pool.Count - visible;
+			renderData.DrawQuads({ m_Quads.data(), visible });
 		}
 
-		void Emit(const ParticleProps& particleProps)
+		void Emit(const ParticleProps& particleProps) { Emit(particleProps, 1); }
+
+		void Emit(const ParticleProps& particleProps, uint32_t amount)
 		{
-			Particle& particle = m_ParticlePool[m_PoolIndex];
-			particle.Active = true;
-			particle.Position = particleProps.Position;
-			particle.Rotation = RandomValue() * 2.f * glm::pi<float>();
+			if (m_Pool.Count + amount > m_Pool.GetCapacity() && m_Pool.GetCapacity() < m_MaxCapacity)
+				m_Pool.Resize(glm::min(std::max({ m_Pool.Count + amount, m_Pool.Count * 2, 64u }), m_MaxCapacity));
 
-			// Velocity
-			particle.Velocity = particleProps.Velocity + particleProps.VelocityVariation * RandomValue();
+			amount = glm::min(amount, m_Pool.GetCapacity() - m_Pool.Count);
 
-			// Color
-			particle.ColorBegin = particleProps.ColorBegin;
-			particle.ColorEnd = particleProps.ColorEnd;
+			// Rotation, velocity and size variation of the whole batch in one go
+			m_RandomValues.resize(amount * 3);
+			m_Random.Fill(m_RandomValues.data(), amount * 3);
 
-			particle.LifeTime = particleProps.LifeTime;
-			particle.LifeRemaining = particleProps.LifeTime;
-			particle.SizeBegin = particleProps.SizeBegin + particleProps.SizeVariation * RandomValue();
-			particle.SizeEnd = particleProps.SizeEnd;
+			for (uint32_t j = 0; j < amount; j++)
+			{
+				const float* random = &m_RandomValues[j * 3];
 
-			m_PoolIndex = --m_PoolIndex % m_ParticlePool.size();
-		}
+				uint32_t i = m_Pool.Count++;
+				m_Pool.Positions[i] = particleProps.Position;
+				m_Pool.Rotations[i] = random[0] * 2.f * glm::pi<float>();
 
-		void Emit(const ParticleProps& particleProps, uint32_t amount)
-		{
-			for (uint32_t i = 0; i < amount; i++) Emit(particleProps);
+				// Velocity
+				m_Pool.Velocities[i] = particleProps.Velocity + particleProps.VelocityVariation * random[1];
+
+				// Color
+				m_Pool.ColorsBegin[i] = particleProps.ColorBegin;
+				m_Pool.ColorsEnd[i] = particleProps.ColorEnd;
+
+				m_Pool.LifeTimes[i] = particleProps.LifeTime;
+				m_Pool.LifeRemaining[i] = particleProps.LifeTime;
+				m_Pool.SizesBegin[i] = particleProps.SizeBegin + particleProps.SizeVariation * random[2];
+				m_Pool.SizesEnd[i] = particleProps.SizeEnd;
+			}
 		}
 
-		void Reset()
+		void Reset() { m_Pool.Count = 0; }
+
+		void Destroy()
 		{
-			memset(m_ParticlePool.data(), 0, sizeof(Particle) * m_ParticlePool.size());
+			m_Pool = {};
+			m_Quads = {};
+			m_RandomValues = {};
 		}
+
+		uint32_t GetAliveCount() const { return m_Pool.Count; }
+		uint32_t GetCapacity() const { return m_Pool.GetCapacity(); }
+		const ParticlePool& GetPool() const { return m_Pool; }
 	private:
-		struct Particle
-		{
-			glm::vec2 Position;
-			glm::vec2 Velocity;
-			glm::vec4 ColorBegin, ColorEnd;
-			float Rotation = 0.0f;
-			float SizeBegin, SizeEnd;
-
-			float LifeTime = 1.0f;
-			float LifeRemaining = 0.0f;
-
-			bool Active = false;
-		};
-		std::vector<Particle> m_ParticlePool;
-		uint32_t m_PoolIndex = 999;
+		ParticlePool m_Pool;
+		std::vector<QuadDesc> m_Quads; // Visible particles of the current frame
+		std::vector<float> m_RandomValues;
+		Random m_Random;
+		uint32_t m_MaxCapacity = 100'000;
 	};
 }
\ No newline at end of file
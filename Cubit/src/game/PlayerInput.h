@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace wc
+{
+	// Everything the player controls for one frame. MapView::GatherInput samples it from the keyboard and mouse,
+	// headless runs build it from a script. "Pressed" fields are only set on the frame the key went down
+	struct PlayerInput
+	{
+		float MoveDir = 0.f; // -1, 0 or 1
+		glm::vec2 Aim = { 1.f, 0.f }; // Normalized direction from the player towards the cursor
+
+		bool Jump = false;            // Pressed
+		bool Dash = false;            // Held
+		bool Fire = false;            // Held
+		bool AltFire = false;         // Held, also zooms weapons that can
+		bool Melee = false;           // Held
+		bool Reload = false;          // Pressed
+		bool SwitchWeapon = false;    // Released, swaps primary and secondary
+		bool SelectPrimary = false;   // Pressed
+		bool SelectSecondary = false; // Pressed
+	};
+}
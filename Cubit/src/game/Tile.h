@@ -2,9 +2,6 @@
 
 #include <glm/glm.hpp>
 #include <vector>
-#include <wc/Utils/CPUImage.h>
-#include "../Rendering/RenderData.h"
-#include "../Globals.h"
 
 namespace wc
 {
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "TileStorage.h"
+
+namespace wc
+{
+	constexpr uint32_t OccupancyLevelCount = 2;
+	constexpr uint32_t OccupancyLevelShift[OccupancyLevelCount] = { 6, 3 }; // 64x64 and 8x8 tile blocks, coarsest first
+
+	// One bit per tile of layer 0 (set for every non-zero TileID) plus per block counts of set tiles on two coarser
+	// levels, so ray walks can skip whole empty blocks. Derived from TileStorage, Map keeps it in sync in SetTile and Load
+	class TileOccupancy
+	{
+	public:
+		void Allocate(glm::uvec2 size)
+		{
+			m_Size = size;
+			m_RowWords = (size.x + 63) >> 6;
+			m_Bits.assign(size_t(m_RowWords) * size.y, 0);
+
+			for (uint32_t level = 0; level < OccupancyLevelCount; level++)
+			{
+				uint32_t shift = OccupancyLevelShift[level];
+				m_BlockCount[level] = (size + (1u << shift) - 1u) >> shift;
+				m_Blocks[level].assign(size_t(m_BlockCount[level].x) * m_BlockCount[level].y, 0);
+			}
+		}
+
+		void Free()
+		{
+			m_Size = glm::uvec2(0);
+			m_RowWords = 0;
+			m_Bits.clear();
+			for (auto& blocks : m_Blocks) blocks.clear();
+		}
+
+		// Rebuilds everything from layer 0 of tiles, only allocated chunks are read
+		void Build(const TileStorage& tiles, glm::uvec2 size)
+		{
+			Allocate(size);
+
+			glm::uvec3 chunkCount = tiles.GetChunkCount();
+			for (uint32_t chunkIndex = 0; chunkIndex < chunkCount.x * chunkCount.y; chunkIndex++)
+			{
+				if (tiles.IsChunkEmpty(chunkIndex)) continue;
+
+				glm::uvec2 min, max;
+				tiles.GetChunkBounds(chunkIndex, min, max);
+				const TileChunk& chunk = tiles.GetChunk(chunkIndex);
+				for (uint32_t y = min.y; y < max.y; y++)
+					for (uint32_t x = min.x; x < max.x; x++)
+						if (chunk.Tiles[TileStorage::GetLocalIndex({ x, y, 0 })]) Set(x, y, true);
+			}
+		}
+
+		void Set(uint32_t x, uint32_t y, bool set)
+		{
+			uint64_t& word = m_Bits[size_t(y) * m_RowWords + (x >> 6)];
+			uint64_t bit = 1ull << (x & 63);
+			if (bool(word & bit) == set) return;
+
+			word ^= bit;
+			for (uint32_t level = 0; level < OccupancyLevelCount; level++)
+			{
+				uint32_t shift = OccupancyLevelShift[level];
+				uint32_t& count = m_Blocks[level][size_t(y >> shift) * m_BlockCount[level].x + (x >> shift)];
+				count += set ? 1 : -1;
+			}
+		}
+
+		// Everything outside of the map is empty
+		bool IsSet(int32_t x, int32_t y) const
+		{
+			if (uint32_t(x) >= m_Size.x || uint32_t(y) >= m_Size.y) return false;
+			return m_Bits[size_t(y) * m_RowWords + (uint32_t(x) >> 6)] >> (x & 63) & 1;
+		}
+
+		// Block coordinates are tile coordinates shifted by OccupancyLevelShift[level], blocks outside of the map are empty
+		bool IsBlockEmpty(uint32_t level, int32_t blockX, int32_t blockY) const
+		{
+			glm::uvec2 count = m_BlockCount[level];
+			if (uint32_t(blockX) >= count.x || uint32_t(blockY) >= count.y) return true;
+			return m_Blocks[level][size_t(blockY) * count.x + blockX] == 0;
+		}
+
+		glm::uvec2 GetSize() const { return m_Size; }
+		uint32_t GetRowWords() const { return m_RowWords; }
+		const uint64_t* GetBits() const { return m_Bits.data(); }
+		size_t GetMemoryUsage() const
+		{
+			size_t bytes = m_Bits.size() * sizeof(uint64_t);
+			for (auto& blocks : m_Blocks) bytes += blocks.size() * sizeof(uint32_t);
+			return bytes;
+		}
+	private:
+		glm::uvec2 m_Size = glm::uvec2(0);
+		uint32_t m_RowWords = 0;
+		std::vector<uint64_t> m_Bits; // Row-major, m_RowWords words per row
+
+		glm::uvec2 m_BlockCount[OccupancyLevelCount] = {};
+		std::vector<uint32_t> m_Blocks[OccupancyLevelCount]; // Number of set tiles in every block
+	};
+}
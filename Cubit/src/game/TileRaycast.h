@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../Rendering/Quad.h"
+#include "Raycasting.h"
+#include "TileOccupancy.h"
+
+namespace wc
+{
+	constexpr float TileRayMaxDistance = 36.f; // Default reach of Map::Intersect
+
+	// Rays in structure-of-arrays layout so IntersectTiles can load four of them at once
+	struct RayBatch
+	{
+		std::vector<float> OriginX, OriginY;
+		std::vector<float> DirectionX, DirectionY;
+		std::vector<float> MaxDistance;
+		uint32_t Count = 0;
+
+		void Resize(uint32_t count)
+		{
+			OriginX.resize(count);
+			OriginY.resize(count);
+			DirectionX.resize(count);
+			DirectionY.resize(count);
+			MaxDistance.resize(count);
+			Count = count;
+		}
+
+		void Set(uint32_t i, const Ray& ray, float maxDistance)
+		{
+			OriginX[i] = ray.Origin.x;
+			OriginY[i] = ray.Origin.y;
+			DirectionX[i] = ray.Direction.x;
+			DirectionY[i] = ray.Direction.y;
+			MaxDistance[i] = maxDistance;
+		}
+	};
+
+	// DDA state along one axis. Tiles are centered on integer coordinates, boundary crossing n of the ray is at
+	// First + n * UnitStep and moves it Step tiles. Computing crossings from n instead of summing them up lets
+	// IntersectTiles jump over empty blocks and still land on exactly the same distances as the tile by tile walk
+	struct TileRayAxis
+	{
+		int32_t Tile;   // Tile containing the origin
+		int32_t Step;
+		float First;    // Distance to the first boundary, infinite if the ray is parallel to the axis
+		float UnitStep; // Distance between boundaries
+
+		TileRayAxis(float origin, float direction)
+		{
+			Tile = int32_t(glm::round(origin));
+			Step = int32_t(glm::sign(direction));
+			if (Step == 0)
+			{
+				First = INFINITY;
+				UnitStep = 0.f;
+				return;
+			}
+
+			UnitStep = glm::abs(1.f / direction);
+			First = ((direction < 0.f ? (origin - float(Tile)) : (float(Tile) - origin)) + 0.5f) * UnitStep;
+		}
+
+		float Crossing(int32_t n) const { return First + float(n) * UnitStep; }
+
+		// Tile after n crossings
+		int32_t GetTile(int32_t n) const { return Tile + n * Step; }
+
+		// Index of the first crossing at or past (inclusive) or strictly past distance, starting the search at n
+		int32_t FindCrossing(int32_t n, float distance, bool inclusive) const
+		{
+			if (Step == 0) return n;
+
+			auto before = [&](int32_t i) { return inclusive ? Crossing(i) < distance : Crossing(i) <= distance; };
+			int32_t start = n;
+			n = glm::max(n, int32_t((distance - First) / UnitStep));
+			while (n > start && !before(n - 1)) n--;
+			while (before(n)) n++;
+			return n;
+		}
+	};
+
+	// Walks the tiles along the ray one by one until one is set or maxDistance is passed. Returns the distance to
+	// the boundary of the hit tile and its normal, FLT_MAX if nothing was hit. The tile containing the origin is skipped
+	inline float IntersectTilesScalar(const TileOccupancy& occupancy, glm::vec2 origin, glm::vec2 direction, float maxDistance, glm::vec2& normal)
+	{
+		TileRayAxis x(origin.x, direction.x), y(origin.y, direction.y);
+		int32_t nx = 0, ny = 0;
+
+		float distance = 0.f;
+		while (distance < maxDistance)
+		{
+			// Walk along the shortest path
+			float lengthX = x.Crossing(nx), lengthY = y.Crossing(ny);
+			bool stepY = lengthX > lengthY;
+			distance = stepY ? lengthY : lengthX;
+			(stepY ? ny : nx)++;
+
+			if (occupancy.IsSet(x.GetTile(nx), y.GetTile(ny)))
+			{
+				normal = stepY ? glm::vec2(0.f, -float(y.Step)) : glm::vec2(-float(x.Step), 0.f);
+				return distance;
+			}
+		}
+		return FLT_MAX;
+	}
+
+	// Same result as IntersectTilesScalar, but whenever the ray is inside an empty occupancy block it jumps straight
+	// to the crossing that leaves the block, long rays through open space only touch a few cells
+	inline float IntersectTiles(const TileOccupancy& occupancy, glm::vec2 origin, glm::vec2 direction, float maxDistance, glm::vec2& normal)
+	{
+		TileRayAxis x(origin.x, direction.x), y(origin.y, direction.y);
+		int32_t nx = 0, ny = 0;
+
+		float distance = 0.f;
+		while (distance < maxDistance)
+		{
+			int32_t tileX = x.GetTile(nx), tileY = y.GetTile(ny);
+			for (uint32_t level = 0; level < OccupancyLevelCount; level++)
+			{
+				uint32_t shift = OccupancyLevelShift[level];
+				int32_t blockX = tileX >> shift, blockY = tileY >> shift;
+				if (!occupancy.IsBlockEmpty(level, blockX, blockY)) continue;
+
+				// Crossings left until the ray leaves the block along each axis
+				int32_t exitX = x.Step > 0 ? ((blockX + 1) << shift) - tileX : x.Step < 0 ? tileX - (blockX << shift) + 1 : 0;
+				int32_t exitY = y.Step > 0 ? ((blockY + 1) << shift) - tileY : y.Step < 0 ? tileY - (blockY << shift) + 1 : 0;
+				float exitDistanceX = x.Step ? x.Crossing(nx + exitX - 1) : INFINITY;
+				float exitDistanceY = y.Step ? y.Crossing(ny + exitY - 1) : INFINITY;
+
+				// Skip every crossing the tile by tile walk would take before the exit, x goes first on ties
+				int32_t skipX, skipY;
+				if (exitDistanceX > exitDistanceY)
+				{
+					skipY = ny + exitY - 1;
+					skipX = x.FindCrossing(nx, exitDistanceY, false);
+				}
+				else
+				{
+					skipX = nx + exitX - 1;
+					skipY = y.FindCrossing(ny, exitDistanceX, true);
+				}
+
+				if (skipX > nx) distance = glm::max(distance, x.Crossing(skipX - 1));
+				if (skipY > ny) distance = glm::max(distance, y.Crossing(skipY - 1));
+				nx = skipX;
+				ny = skipY;
+				break;
+			}
+			if (distance >= maxDistance) break;
+
+			float lengthX = x.Crossing(nx), lengthY = y.Crossing(ny);
+			bool stepY = lengthX > lengthY;
+			distance = stepY ? lengthY : lengthX;
+			(stepY ? ny : nx)++;
+
+			if (occupancy.IsSet(x.GetTile(nx), y.GetTile(ny)))
+			{
+				normal = stepY ? glm::vec2(0.f, -float(y.Step)) : glm::vec2(-float(x.Step), 0.f);
+				return distance;
+			}
+		}
+		return FLT_MAX;
+	}
+
+	// Whether a set tile lies between a and b, for line of sight checks. The tile containing a is skipped,
+	// a set tile containing b does block the segment
+	inline bool IsSegmentBlocked(const TileOccupancy& occupancy, glm::vec2 a, glm::vec2 b)
+	{
+		glm::vec2 delta = b - a;
+		float length = glm::length(delta);
+		if (length == 0.f) return false;
+
+		glm::vec2 normal;
+		return IntersectTiles(occupancy, a, delta / length, length, normal) < length;
+	}
+
+	// IntersectTilesScalar for every ray in the batch, writes FLT_MAX to t for rays that hit nothing.
+	// Four lanes are stepped together and a lane takes the next ray as soon as its current one is done, so short
+	// rays don't leave lanes idle. Bounds checks and bit addresses are computed for all lanes, only the loads are scalar
+	inline void IntersectTiles(const TileOccupancy& occupancy, const RayBatch& rays, float* t, glm::vec2* normals)
+	{
+		uint32_t i = 0;
+		glm::uvec2 size = occupancy.GetSize();
+#ifdef WC_QUAD_SSE
+		// The word address is computed with 16 bit multiplies
+		if (size.x > 0 && size.y > 0 && size.y < 32768 && occupancy.GetRowWords() < 32768)
+		{
+			struct alignas(16) Lanes
+			{
+				int32_t TileX[4], TileY[4], StepX[4], StepY[4];
+				float FirstX[4], FirstY[4], UnitX[4], UnitY[4];
+				float CountX[4], CountY[4];        // Crossings taken so far, exact as floats
+				float Distance[4], MaxDistance[4]; // Distance is only written back when rays finish
+				int32_t Active[4];
+				int32_t Ray[4];
+			} lanes;
+
+			auto fill = [&](uint32_t j)
+				{
+					// Rays without any distance to walk are done right away
+					while (i < rays.Count && !(rays.MaxDistance[i] > 0.f))
+						t[i++] = FLT_MAX;
+
+					lanes.Active[j] = 0;
+					lanes.Ray[j] = -1;
+					if (i == rays.Count) return;
+
+					TileRayAxis x(rays.OriginX[i], rays.DirectionX[i]);
+					TileRayAxis y(rays.OriginY[i], rays.DirectionY[i]);
+					lanes.TileX[j] = x.Tile; lanes.StepX[j] = x.Step; lanes.FirstX[j] = x.First; lanes.UnitX[j] = x.UnitStep;
+					lanes.TileY[j] = y.Tile; lanes.StepY[j] = y.Step; lanes.FirstY[j] = y.First; lanes.UnitY[j] = y.UnitStep;
+					lanes.CountX[j] = 0.f;
+					lanes.CountY[j] = 0.f;
+					lanes.MaxDistance[j] = rays.MaxDistance[i];
+					lanes.Active[j] = -1;
+					lanes.Ray[j] = i++;
+				};
+
+			for (uint32_t j = 0; j < 4; j++) fill(j);
+
+			__m128i tx, ty, sx, sy;
+			__m128 fx, fy, ux, uy, nx, ny, maxDistance, active;
+			auto load = [&]
+				{
+					tx = _mm_load_si128((const __m128i*)lanes.TileX); ty = _mm_load_si128((const __m128i*)lanes.TileY);
+					sx = _mm_load_si128((const __m128i*)lanes.StepX); sy = _mm_load_si128((const __m128i*)lanes.StepY);
+					fx = _mm_load_ps(lanes.FirstX); fy = _mm_load_ps(lanes.FirstY);
+					ux = _mm_load_ps(lanes.UnitX); uy = _mm_load_ps(lanes.UnitY);
+					nx = _mm_load_ps(lanes.CountX); ny = _mm_load_ps(lanes.CountY);
+					maxDistance = _mm_load_ps(lanes.MaxDistance);
+					active = _mm_load_ps((const float*)lanes.Active);
+				};
+			load();
+
+			const uint64_t* bits = occupancy.GetBits();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128i signBit = _mm_set1_epi32(INT32_MIN);
+			const __m128i sizeX = _mm_set1_epi32(int32_t(size.x ^ 0x80000000u)), sizeY = _mm_set1_epi32(int32_t(size.y ^ 0x80000000u));
+			const __m128i rowStride = _mm_set1_epi32(int32_t(occupancy.GetRowWords() << 16 | 1));
+			const __m128i bitMask = _mm_set1_epi32(63);
+
+			// The lanes only change in the rarely taken branch at the end, so the next step doesn't have to wait for the loads
+			int activeBits = _mm_movemask_ps(active);
+			while (activeBits)
+			{
+				// Walk along the shortest path, empty lanes keep their state
+				__m128 lx = _mm_add_ps(fx, _mm_mul_ps(nx, ux));
+				__m128 ly = _mm_add_ps(fy, _mm_mul_ps(ny, uy));
+				__m128 axisY = _mm_cmpgt_ps(lx, ly);
+				__m128 moveX = _mm_andnot_ps(axisY, active);
+				__m128 moveY = _mm_and_ps(axisY, active);
+
+				tx = _mm_add_epi32(tx, _mm_and_si128(sx, _mm_castps_si128(moveX)));
+				ty = _mm_add_epi32(ty, _mm_and_si128(sy, _mm_castps_si128(moveY)));
+				nx = _mm_add_ps(nx, _mm_and_ps(one, moveX));
+				ny = _mm_add_ps(ny, _mm_and_ps(one, moveY));
+				__m128 distance = _mm_or_ps(_mm_and_ps(axisY, ly), _mm_andnot_ps(axisY, lx));
+
+				// Bounds check as unsigned compares, lanes outside of the map read bit 0 and are masked out
+				__m128i inside = _mm_and_si128(
+					_mm_cmpgt_epi32(sizeX, _mm_xor_si128(tx, signBit)),
+					_mm_cmpgt_epi32(sizeY, _mm_xor_si128(ty, signBit)));
+				__m128i x = _mm_and_si128(tx, inside), y = _mm_and_si128(ty, inside);
+
+				// y * rowWords + (x >> 6)
+				__m128i word = _mm_madd_epi16(_mm_or_si128(_mm_srli_epi32(x, 6), _mm_slli_epi32(y, 16)), rowStride);
+				__m128i bit = _mm_and_si128(x, bitMask);
+
+				alignas(16) int32_t wordIndex[4], bitIndex[4];
+				_mm_store_si128((__m128i*)wordIndex, word);
+				_mm_store_si128((__m128i*)bitIndex, bit);
+				int setBits = 0;
+				for (uint32_t j = 0; j < 4; j++)
+					setBits |= int(bits[wordIndex[j]] >> bitIndex[j] & 1) << j;
+
+				int hitBits = setBits & _mm_movemask_ps(_mm_castsi128_ps(inside));
+				int doneBits = (hitBits | _mm_movemask_ps(_mm_cmpnlt_ps(distance, maxDistance))) & activeBits;
+
+				// Write out the finished rays and refill their lanes
+				if (doneBits)
+				{
+					_mm_store_si128((__m128i*)lanes.TileX, tx); _mm_store_si128((__m128i*)lanes.TileY, ty);
+					_mm_store_ps(lanes.CountX, nx); _mm_store_ps(lanes.CountY, ny);
+					_mm_store_ps(lanes.Distance, distance);
+
+					int axisBits = _mm_movemask_ps(axisY);
+					for (uint32_t j = 0; j < 4; j++)
+					{
+						if (!(doneBits >> j & 1)) continue;
+
+						uint32_t ray = lanes.Ray[j];
+						if (hitBits >> j & 1)
+						{
+							t[ray] = lanes.Distance[j];
+							normals[ray] = (axisBits >> j & 1) ? glm::vec2(0.f, -float(lanes.StepY[j])) : glm::vec2(-float(lanes.StepX[j]), 0.f);
+						}
+						else t[ray] = FLT_MAX;
+
+						fill(j);
+					}
+					load();
+					activeBits = _mm_movemask_ps(active);
+				}
+			}
+		}
+#endif
+		for (; i < rays.Count; i++)
+			t[i] = IntersectTilesScalar(occupancy, { rays.OriginX[i], rays.OriginY[i] }, { rays.DirectionX[i], rays.DirectionY[i] }, rays.MaxDistance[i], normals[i]);
+	}
+}
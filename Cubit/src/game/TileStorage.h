@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Tile.h"
+
+namespace wc
+{
+	constexpr uint32_t ChunkShift = 5;
+	constexpr uint32_t ChunkSize = 1 << ChunkShift; // Chunks are ChunkSize x ChunkSize tiles of a single layer
+	constexpr uint32_t ChunkMask = ChunkSize - 1;
+	constexpr uint32_t ChunkTileCount = ChunkSize * ChunkSize;
+
+	enum ChunkDirtyFlags : uint8_t
+	{
+		CHUNK_DIRTY_PHYSICS = 1 << 0,
+		CHUNK_DIRTY_RENDER = 1 << 1,
+
+		CHUNK_DIRTY_ALL = CHUNK_DIRTY_PHYSICS | CHUNK_DIRTY_RENDER,
+	};
+
+	struct TileChunk
+	{
+		TileID Tiles[ChunkTileCount] = {};
+		uint32_t TileCount = 0; // Number of non-empty tiles
+	};
+
+	// Sparse tile grid. Chunks are only allocated once a non-empty tile is written to them,
+	// every other slot points to a shared all-empty chunk so reads never have to branch
+	struct TileStorage
+	{
+		TileStorage() = default;
+		~TileStorage() { Free(); }
+
+		TileStorage(const TileStorage&) = delete;
+		TileStorage& operator=(const TileStorage&) = delete;
+
+		void Allocate(const glm::uvec3& size)
+		{
+			Free();
+			m_Size = size;
+			m_ChunkCount = { (size.x + ChunkMask) >> ChunkShift, (size.y + ChunkMask) >> ChunkShift, size.z };
+
+			uint32_t chunkCount = m_ChunkCount.x * m_ChunkCount.y * m_ChunkCount.z;
+			m_Chunks.assign(chunkCount, &s_EmptyChunk);
+			m_Dirty.assign(chunkCount, CHUNK_DIRTY_ALL);
+		}
+
+		void Free()
+		{
+			for (auto chunk : m_Chunks)
+				if (chunk != &s_EmptyChunk) delete chunk;
+
+			m_Chunks.clear();
+			m_Dirty.clear();
+			m_AllocatedChunks = 0;
+		}
+
+		bool IsAllocated() const { return !m_Chunks.empty(); }
+
+		TileID Get(const glm::uvec3& pos) const { return m_Chunks[GetChunkIndex(pos)]->Tiles[GetLocalIndex(pos)]; }
+
+		void Set(const glm::uvec3& pos, TileID tile)
+		{
+			uint32_t index = GetChunkIndex(pos);
+			TileChunk* chunk = m_Chunks[index];
+
+			if (chunk == &s_EmptyChunk)
+			{
+				if (tile == 0) return;
+				chunk = AllocateChunk(index);
+			}
+
+			TileID& dst = chunk->Tiles[GetLocalIndex(pos)];
+			if (dst == tile) return;
+
+			if (dst == 0) chunk->TileCount++;
+			else if (tile == 0) chunk->TileCount--;
+			dst = tile;
+
+			MarkDirty(pos);
+			if (chunk->TileCount == 0) FreeChunk(index);
+		}
+
+		// Writes count copies of tile starting at a linear offset (same order as to1D)
+		void Fill(size_t offset, TileID tile, size_t count)
+		{
+			while (count > 0)
+			{
+				glm::uvec3 pos = FromLinear(offset);
+				uint32_t run = (uint32_t)glm::min<size_t>(count, glm::min(ChunkSize - (pos.x & ChunkMask), m_Size.x - pos.x));
+
+				uint32_t index = GetChunkIndex(pos);
+				if (tile != 0 || m_Chunks[index] != &s_EmptyChunk)
+				{
+					TileChunk* chunk = m_Chunks[index] == &s_EmptyChunk ? AllocateChunk(index) : m_Chunks[index];
+					TileID* dst = &chunk->Tiles[GetLocalIndex(pos)];
+
+					for (uint32_t i = 0; i < run; i++) chunk->TileCount -= dst[i] != 0;
+					memset(dst, tile, run * sizeof(TileID));
+					if (tile != 0) chunk->TileCount += run;
+
+					m_Dirty[index] |= CHUNK_DIRTY_ALL;
+					if (chunk->TileCount == 0) FreeChunk(index);
+				}
+
+				offset += run;
+				count -= run;
+			}
+		}
+
+		// Copies a dense tile array (same order as to1D), skipping chunk rows that are entirely empty
+		void CopyFrom(const TileID* src)
+		{
+			for (uint32_t z = 0; z < m_Size.z; z++)
+				for (uint32_t y = 0; y < m_Size.y; y++)
+				{
+					const TileID* row = src + (size_t(z) * m_Size.y + y) * m_Size.x;
+					for (uint32_t x = 0; x < m_Size.x; x += ChunkSize)
+					{
+						uint32_t run = glm::min(ChunkSize, m_Size.x - x);
+
+						bool empty = true;
+						for (uint32_t i = 0; i < run && empty; i++) empty = row[x + i] == 0;
+
+						uint32_t index = GetChunkIndex({ x, y, z });
+						if (empty && m_Chunks[index] == &s_EmptyChunk) continue;
+
+						TileChunk* chunk = m_Chunks[index] == &s_EmptyChunk ? AllocateChunk(index) : m_Chunks[index];
+						memcpy(&chunk->Tiles[GetLocalIndex({ x, y, z })], row + x, run * sizeof(TileID));
+					}
+				}
+
+			for (uint32_t i = 0; i < m_Chunks.size(); i++)
+				if (m_Chunks[i] != &s_EmptyChunk) RecountChunk(i);
+		}
+
+		// Flags every chunk touching the 3x3 tiles around pos, faces and chain ghost vertices
+		// of tiles on a chunk border depend on their neighbours
+		void MarkDirty(const glm::uvec3& pos, uint8_t flags = CHUNK_DIRTY_ALL)
+		{
+			glm::uvec3 min = { pos.x > 0 ? pos.x - 1 : 0, pos.y > 0 ? pos.y - 1 : 0, pos.z };
+			glm::uvec3 max = { glm::min(pos.x + 1, m_Size.x - 1), glm::min(pos.y + 1, m_Size.y - 1), pos.z };
+
+			for (uint32_t y = min.y >> ChunkShift; y <= max.y >> ChunkShift; y++)
+				for (uint32_t x = min.x >> ChunkShift; x <= max.x >> ChunkShift; x++)
+					m_Dirty[(pos.z * m_ChunkCount.y + y) * m_ChunkCount.x + x] |= flags;
+		}
+
+		bool IsDirty(uint32_t chunkIndex, uint8_t flags) const { return m_Dirty[chunkIndex] & flags; }
+		void ClearDirty(uint32_t chunkIndex, uint8_t flags) { m_Dirty[chunkIndex] &= ~flags; }
+
+		template<typename Func>
+		void ForEachDirty(uint8_t flags, Func&& func)
+		{
+			for (uint32_t i = 0; i < m_Dirty.size(); i++)
+				if (m_Dirty[i] & flags)
+				{
+					func(i);
+					m_Dirty[i] &= ~flags;
+				}
+		}
+
+		bool IsChunkEmpty(uint32_t chunkIndex) const { return m_Chunks[chunkIndex] == &s_EmptyChunk; }
+		const TileChunk& GetChunk(uint32_t chunkIndex) const { return *m_Chunks[chunkIndex]; }
+
+		uint32_t GetChunkIndex(const glm::uvec3& pos) const { return (pos.z * m_ChunkCount.y + (pos.y >> ChunkShift)) * m_ChunkCount.x + (pos.x >> ChunkShift); }
+		static uint32_t GetLocalIndex(const glm::uvec3& pos) { return ((pos.y & ChunkMask) << ChunkShift) + (pos.x & ChunkMask); }
+
+		// Chunk grid coordinates (x, y, layer) of a chunk index
+		glm::uvec3 GetChunkCoords(uint32_t chunkIndex) const
+		{
+			return { chunkIndex % m_ChunkCount.x, (chunkIndex / m_ChunkCount.x) % m_ChunkCount.y, chunkIndex / (m_ChunkCount.x * m_ChunkCount.y) };
+		}
+
+		// Tile-space bounds of a chunk clamped to the map size, max is exclusive
+		void GetChunkBounds(uint32_t chunkIndex, glm::uvec2& min, glm::uvec2& max) const
+		{
+			glm::uvec3 coords = GetChunkCoords(chunkIndex);
+			min = glm::uvec2(coords) * ChunkSize;
+			max = glm::min(min + ChunkSize, glm::uvec2(m_Size));
+		}
+
+		glm::uvec3 GetChunkCount() const { return m_ChunkCount; }
+		uint32_t GetChunkTotal() const { return (uint32_t)m_Chunks.size(); }
+		uint32_t GetAllocatedChunkCount() const { return m_AllocatedChunks; }
+		size_t GetMemoryUsage() const { return m_AllocatedChunks * sizeof(TileChunk) + m_Chunks.size() * (sizeof(TileChunk*) + sizeof(uint8_t)); }
+
+	private:
+		inline static TileChunk s_EmptyChunk; // Shared by every unallocated slot, never written to
+
+		glm::uvec3 m_Size = glm::uvec3(0);
+		glm::uvec3 m_ChunkCount = glm::uvec3(0);
+		std::vector<TileChunk*> m_Chunks;
+		std::vector<uint8_t> m_Dirty;
+		uint32_t m_AllocatedChunks = 0;
+
+		glm::uvec3 FromLinear(size_t offset) const
+		{
+			size_t layer = size_t(m_Size.x) * m_Size.y;
+			return { uint32_t(offset % m_Size.x), uint32_t((offset % layer) / m_Size.x), uint32_t(offset / layer) };
+		}
+
+		TileChunk* AllocateChunk(uint32_t index)
+		{
+			m_Chunks[index] = new TileChunk();
+			m_Dirty[index] |= CHUNK_DIRTY_ALL;
+			m_AllocatedChunks++;
+			return m_Chunks[index];
+		}
+
+		void FreeChunk(uint32_t index)
+		{
+			delete m_Chunks[index];
+			m_Chunks[index] = &s_EmptyChunk;
+			m_Dirty[index] |= CHUNK_DIRTY_ALL;
+			m_AllocatedChunks--;
+		}
+
+		void RecountChunk(uint32_t index)
+		{
+			TileChunk* chunk = m_Chunks[index];
+			chunk->TileCount = 0;
+			for (uint32_t i = 0; i < ChunkTileCount; i++) chunk->TileCount += chunk->Tiles[i] != 0;
+
+			m_Dirty[index] |= CHUNK_DIRTY_ALL;
+			if (chunk->TileCount == 0) FreeChunk(index);
+		}
+	};
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <magic_enum.hpp>
 
 namespace wc
 {
@@ -19,8 +20,8 @@ namespace wc
 	struct WeaponInfo
 	{
 		bool CloseRange = false;
-		BulletType BulletType = BulletType::Blaster;
-		WeaponClass WeaponClass = WeaponClass::Primary;
+		wc::BulletType BulletType = wc::BulletType::Blaster;
+		wc::WeaponClass WeaponClass = wc::WeaponClass::Primary;
 		uint32_t Damage = 0;
 		bool CanZoom = false;
 		float FireRate = 0.f;
@@ -13,6 +13,7 @@
 #define MSDFGEN_PUBLIC // ???
 
 #include "Application.h"
+#include "CommandLine.h"
 
 //DANGEROUS!
 #pragma warning(push, 0)
@@ -38,9 +39,16 @@ namespace wc
 {
 	Application app;
 
-	int main()
+	int main(int argc, char** argv)
 	{
 		Log::Init();
+
+		// --bench, --headless, --replay and --convert run without a window or Vulkan device
+		int exitCode = 0;
+		if (RunCommandLine(argc, argv, exitCode)) return exitCode;
+
+		if (argc > 2 && std::string_view(argv[1]) == "--record") app.SetRecordPath(argv[2]);
+
 		glfwSetErrorCallback([](int error, const char* description)
 			{
 				switch (error)
@@ -90,7 +98,7 @@ namespace wc
 	}
 }
 
-int main()
+int main(int argc, char** argv)
 {
-	return wc::main();
+	return wc::main(argc, argv);
 }
\ No newline at end of file
@@ -1,17 +1,7 @@
 #pragma shader_stage(vertex)
+#include "Quad.glsl"
 
-struct Vertex 
-{
-	vec3 Position;
-	uint TextureID;
-	vec2 TexCoords;
-	float Fade;
-	float Thickness;
-
-	vec4 Color;
-};
-
-layout (std430, binding = 0) readonly buffer VertexBuffer { Vertex vertices[]; };
+layout (std430, binding = 0) readonly buffer QuadBuffer { QuadInstance quads[]; };
 
 layout(location = 0) out vec2 v_TexCoords;
 layout(location = 1) out flat uint v_TexID;
@@ -21,7 +11,7 @@ layout(location = 4) out float v_Thickness;
 
 void main() 
 {
-	Vertex vertex = vertices[gl_VertexIndex];
+	QuadVertex vertex = ExpandQuad(quads[gl_VertexIndex / 6], gl_VertexIndex % 6);
 
     v_TexCoords = vertex.TexCoords;
 	v_TexID = vertex.TextureID;
@@ -29,5 +19,5 @@ void main()
 	v_Fade = vertex.Fade;
 	v_Thickness = vertex.Thickness;
 
-    gl_Position = vec4(vertex.Position, 1.f);
+    gl_Position = vec4(vertex.Position, 0.f, 1.f);
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma shader_stage(vertex)
+#extension GL_EXT_buffer_reference : require
+#include "Quad.glsl"
+
+layout (std430, buffer_reference, buffer_reference_align = 16) readonly buffer QuadBuffer { QuadInstance quads[]; };
+
+layout (push_constant) uniform Uniforms
+{
+	mat4 ViewProjection;
+	QuadBuffer Mesh;
+};
+
+layout(location = 0) out vec2 v_TexCoords;
+layout(location = 1) out flat uint v_TexID;
+layout(location = 2) out vec4 v_Color;
+layout(location = 3) out float v_Fade;
+layout(location = 4) out float v_Thickness;
+
+void main() 
+{
+	QuadVertex vertex = ExpandQuad(Mesh.quads[gl_VertexIndex / 6], gl_VertexIndex % 6);
+
+    v_TexCoords = vertex.TexCoords;
+	v_TexID = vertex.TextureID;
+	v_Color = vertex.Color;
+	v_Fade = vertex.Fade;
+	v_Thickness = vertex.Thickness;
+
+    gl_Position = ViewProjection * vec4(vertex.Position, 0.f, 1.f);
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef QUAD_GLSL
+#define QUAD_GLSL
+
+// Mirrors QuadInstance in Quad.h, one record per quad expanded into 6 vertices
+const uint QUAD_CIRCLE = 1;
+const uint QUAD_MSDF = 2;
+const uint QUAD_UV_RECT = 4;
+const uint QUAD_TRIANGLE = 8;
+
+struct QuadInstance
+{
+	vec2 Center;
+	vec2 AxisX;
+	vec2 AxisY;
+	uvec2 Color;       // RGBA as halfs
+	uvec2 UV;          // Min and max texture coordinates as unorm16 pairs
+	uint TextureFlags; // Texture index in the low 16 bits, flags above
+	uint Params;       // Thickness and fade as halfs
+};
+
+struct QuadVertex
+{
+	vec2 Position;
+	vec2 TexCoords;
+	uint TextureID;
+	vec4 Color;
+	float Fade;
+	float Thickness;
+};
+
+// Corners in the order of the old index pattern 0, 1, 2, 2, 3, 0
+const vec2 QuadCorners[6] = vec2[](vec2(0.5, 0.5), vec2(-0.5, 0.5), vec2(-0.5, -0.5), vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(0.5, 0.5));
+
+// Triangles use the first three vertices, the rest collapse into a degenerate triangle
+const vec2 TriangleCorners[3] = vec2[](vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(0.0, 0.5));
+const vec2 TriangleTexCoords[3] = vec2[](vec2(1.0, 0.0), vec2(0.0, 0.0), vec2(0.0, 1.0));
+
+QuadVertex ExpandQuad(QuadInstance quad, uint corner)
+{
+	uint flags = quad.TextureFlags >> 16;
+
+	QuadVertex vertex;
+	vec2 local;
+	if ((flags & QUAD_TRIANGLE) != 0)
+	{
+		uint index = min(corner, 2u);
+		local = TriangleCorners[index];
+		vertex.TexCoords = TriangleTexCoords[index];
+	}
+	else
+	{
+		local = QuadCorners[corner];
+		vertex.TexCoords = vec2(local.x + 0.5, 0.5 - local.y);
+	}
+
+	vertex.Position = quad.Center + quad.AxisX * local.x + quad.AxisY * local.y;
+	vertex.TextureID = quad.TextureFlags & 0xFFFFu;
+	vertex.Color = vec4(unpackHalf2x16(quad.Color.x), unpackHalf2x16(quad.Color.y));
+	vertex.Fade = 0.0;
+	vertex.Thickness = 0.0;
+
+	if ((flags & QUAD_UV_RECT) != 0) vertex.TexCoords = mix(unpackUnorm2x16(quad.UV.x), unpackUnorm2x16(quad.UV.y), local + 0.5);
+
+	if ((flags & QUAD_CIRCLE) != 0)
+	{
+		vec2 params = unpackHalf2x16(quad.Params);
+		vertex.TexCoords = local * 2.0;
+		vertex.Thickness = params.x;
+		vertex.Fade = params.y;
+	}
+	else if ((flags & QUAD_MSDF) != 0) vertex.Thickness = -1.0;
+
+	return vertex;
+}
+
+#endif
\ No newline at end of file